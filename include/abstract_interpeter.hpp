@@ -5,7 +5,19 @@
 #include "ast.hpp"
 #include "interval.hpp"
 #include "interval_store.hpp"
+#include "linearization.hpp"
+#include "analysis_profile.hpp"
+#include "counted_loop.hpp"
+#include "interval_transfer.hpp"
+#include "iteration_history.hpp"
+#include "report.hpp"
+#include <algorithm>
+#include <deque>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <tuple>
 #include <stdexcept>
 #include <iostream>
 #include <functional>
@@ -29,12 +41,100 @@ LogicOp negate_logic_op(LogicOp op)
     case LogicOp::GEQ:
         return LogicOp::LE;
     default:
-        std::cerr << "Unsupported logical operation" << std::endl;
+        report_err() << "Unsupported logical operation" << std::endl;
         return LogicOp::EQ;
     }
 }
 
-Interval<int64_t> evalArithmeticExpr(const ASTNode &node, const Store& store)
+// The negations of a guard pushed down to its comparisons (De Morgan), so
+// that only && and || are left above them.
+ASTNode normalize_guard(const ASTNode &guard, bool negated = false)
+{
+    if (guard.type == NodeType::LOGIC_OP)
+    {
+        ASTNode comparison = guard;
+        if (negated) comparison.value = negate_logic_op(std::get<LogicOp>(guard.value));
+        return comparison;
+    }
+    if (guard.type != NodeType::BOOL_OP) return normalize_guard(ASTNode(LogicOp::NEQ, guard, ASTNode(0)), negated);
+    const std::string &op = std::get<std::string>(guard.value);
+    if (op == "!") return normalize_guard(guard.children[0], !negated);
+    ASTNode connective(NodeType::BOOL_OP, std::string(negated == (op == "&&") ? "||" : "&&"));
+    for (const auto &child : guard.children) connective.children.push_back(normalize_guard(child, negated));
+    return connective;
+}
+
+// Arithmetic nodes built by the parser for `-x` and `x++` hold their operator as a string.
+BinOp get_binop(const ASTNode &node)
+{
+    try {
+        return std::get<BinOp>(node.value);
+    } catch (const std::bad_variant_access&) {
+        std::string op_str = std::get<std::string>(node.value);
+        return op_str == "+" ? BinOp::ADD : 
+               op_str == "-" ? BinOp::SUB : 
+               op_str == "*" ? BinOp::MUL : 
+               op_str == "/" ? BinOp::DIV : BinOp::ADD;
+    }
+}
+
+// Builds the affine form of node, returns false if node is not affine.
+bool to_affine_expr(const ASTNode &node, AffineExpr &expr)
+{
+    if (node.type == NodeType::INTEGER)
+    {
+        expr = AffineExpr{{}, Rational(std::get<int>(node.value))};
+        return true;
+    }
+    else if (node.type == NodeType::VARIABLE)
+    {
+        expr = AffineExpr{{{std::get<std::string>(node.value), Rational(1)}}, Rational(0)};
+        return true;
+    }
+    else if (node.type != NodeType::ARITHM_OP || node.children.size() != 2)
+    {
+        return false;
+    }
+
+    AffineExpr left, right;
+    if (!to_affine_expr(node.children[0], left) || !to_affine_expr(node.children[1], right)) return false;
+    try {
+        switch (get_binop(node))
+        {
+            case BinOp::SUB:
+                for (auto &[var, coef] : right.coeffs) coef = -coef;
+                right.constant = -right.constant;
+                [[fallthrough]];
+            case BinOp::ADD:
+                for (const auto &[var, coef] : right.coeffs) left.coeffs[var] = left.coeffs[var] + coef;
+                left.constant = left.constant + right.constant;
+                break;
+            case BinOp::MUL:
+                // Only a product by a constant stays affine.
+                if (!left.coeffs.empty() && !right.coeffs.empty()) return false;
+                if (left.coeffs.empty()) std::swap(left, right);
+                for (auto &[var, coef] : left.coeffs) coef = coef * right.constant;
+                left.constant = left.constant * right.constant;
+                break;
+            default:
+                // Integer division truncates, it is not affine.
+                return false;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    for (auto it = left.coeffs.begin(); it != left.coeffs.end();) {
+        if (it->second.is_zero()) it = left.coeffs.erase(it);
+        else ++it;
+    }
+    expr = left;
+    return true;
+}
+
+KnownBits evalKnownBits(const ASTNode &node, const Store& store);
+
+// Plain interval evaluation, bottom-up on the expression tree.
+Interval<int64_t> evalIntervalExpr(const ASTNode &node, const Store& store)
 {
     if (node.type == NodeType::INTEGER)
     {
@@ -46,76 +146,88 @@ Interval<int64_t> evalArithmeticExpr(const ASTNode &node, const Store& store)
         std::string var = std::get<std::string>(node.value);
         return store.get_interval(var);
     }
+    else if (node.type == NodeType::ARRAY_ACCESS)
+    {
+        // Out-of-bounds indices are reported by check_bounds, once the fixpoint is reached.
+        std::string var = std::get<std::string>(node.value);
+        if (!store.has_array(var)) return Interval<int64_t>();
+        return store.get_array(var).read(evalIntervalExpr(node.children[0], store));
+    }
+    else if (node.type == NodeType::LOGIC_OP)
+    {
+        return comparison_value(std::get<LogicOp>(node.value), evalIntervalExpr(node.children[0], store), evalIntervalExpr(node.children[1], store));
+    }
     else if (node.type == NodeType::ARITHM_OP)
     {
-        auto left = evalArithmeticExpr(node.children[0], store);
-        auto right = evalArithmeticExpr(node.children[1], store);
-        BinOp op;
-        try {
-            op = std::get<BinOp>(node.value);
-        } catch (const std::bad_variant_access&) {
-            std::string op_str = std::get<std::string>(node.value);
-            op = op_str == "+" ? BinOp::ADD : 
-                 op_str == "-" ? BinOp::SUB : 
-                 op_str == "*" ? BinOp::MUL : 
-                 op_str == "/" ? BinOp::DIV : BinOp::ADD;
-        }
-
-        Interval<int64_t> result;
+        auto left = evalIntervalExpr(node.children[0], store);
+        auto right = evalIntervalExpr(node.children[1], store);
+        BinOp op = get_binop(node);
+
         switch(op)
         {
             case BinOp::ADD:
-            {
                 // Simple overflow check for intervals (clamp seen as a conservative approximation):
                 if ((left.getLower() <= std::numeric_limits<int32_t>::lowest() && right.getLower() < 0) ||
                     (left.getUpper() >= std::numeric_limits<int32_t>::max() && right.getUpper() > 0)) {
-                    std::cerr << "Warning: potential ADD overflow detected, clamping." << std::endl;
+                    report_err() << "Warning: potential ADD overflow detected, clamping." << std::endl;
                 }
-                result = left + right;
                 break;
-            }
             case BinOp::SUB:
-            {
                 // Similar check for SUB:
                 if ((left.getLower() <= std::numeric_limits<int32_t>::lowest() && right.getUpper() > 0) ||
                     (left.getUpper() >= std::numeric_limits<int32_t>::max() && right.getLower() < 0)) {
-                    std::cerr << "Warning: potential SUB overflow detected, clamping." << std::endl;
+                    report_err() << "Warning: potential SUB overflow detected, clamping." << std::endl;
                 }
-                result = left - right;
                 break;
-            }
             case BinOp::MUL:
-            {
                 // Check if either interval spans large values that could overflow:
                 if ((std::abs(left.getLower()) >= std::numeric_limits<int32_t>::max() &&
                     std::abs(right.getLower()) > 1) ||
                     (std::abs(left.getUpper()) >= std::numeric_limits<int32_t>::max() &&
                     std::abs(right.getUpper()) > 1)) {
-                    std::cerr << "Warning: potential MUL overflow detected, clamping." << std::endl;
+                    report_err() << "Warning: potential MUL overflow detected, clamping." << std::endl;
                 }
-                result = left * right;
                 break;
-            }
             case BinOp::DIV:
+                if (right.contains(0)) report_err() << "Warning: division by zero detected, clamping result to full range." << std::endl;
+                break;
+            case BinOp::MOD:
+                if (right.contains(0)) report_err() << "Warning: modulo by zero detected, clamping result to full range." << std::endl;
+                break;
+            case BinOp::AND:
+            case BinOp::OR:
+            case BinOp::XOR:
+            case BinOp::SHL:
+            case BinOp::SHR:
             {
-                // Division by zero check:
-                if (right.contains(0)) {
-                    std::cerr << "Warning: division by zero detected, clamping result to full range." << std::endl;
-                    result = Interval<int64_t>(
-                        std::numeric_limits<int64_t>::lowest(),
-                        std::numeric_limits<int64_t>::max()
-                    );
+                // Reduced product: the known bits bound the result, the
+                // intervals of the operands may bound it further.
+                Interval<int64_t> result = evalKnownBits(node, store).to_interval<int64_t>();
+                bool finite = left.getLower() != std::numeric_limits<int64_t>::lowest() && left.getUpper() != std::numeric_limits<int64_t>::max();
+                if (op == BinOp::AND && (left.getLower() >= 0 || right.getLower() >= 0)) {
+                    int64_t upper = left.getLower() >= 0 && right.getLower() >= 0 ? std::min(left.getUpper(), right.getUpper())
+                        : left.getLower() >= 0 ? left.getUpper() : right.getUpper();
+                    result = result.meet(Interval<int64_t>(0, upper));
                 }
-                else {
-                    result = left / right;
+                else if (op == BinOp::OR && left.getLower() >= 0 && right.getLower() >= 0) {
+                    result = result.meet(Interval<int64_t>(std::max(left.getLower(), right.getLower()), std::numeric_limits<int64_t>::max()));
                 }
-                break;
+                else if (op == BinOp::SHR && finite && right.getLower() >= 0 && right.getUpper() <= 63) {
+                    int64_t c[4] = {left.getLower() >> right.getLower(), left.getLower() >> right.getUpper(),
+                                    left.getUpper() >> right.getLower(), left.getUpper() >> right.getUpper()};
+                    result = result.meet(Interval<int64_t>(std::min({c[0], c[1], c[2], c[3]}), std::max({c[0], c[1], c[2], c[3]})));
+                }
+                else if (op == BinOp::SHL && finite && right.getLower() >= 0 && right.getUpper() <= 31 &&
+                         std::abs(left.getLower()) <= std::numeric_limits<int32_t>::max() && std::abs(left.getUpper()) <= std::numeric_limits<int32_t>::max()) {
+                    result = result.meet(left * Interval<int64_t>(int64_t(1) << right.getLower(), int64_t(1) << right.getUpper()));
+                }
+                return result;
             }
             default:
-                std::cerr << "Unsupported arithmetic operation" << std::endl;
+                report_err() << "Unsupported arithmetic operation" << std::endl;
                 return Interval<int64_t>();
         }
-        return result;
+        return interval_arithmetic(op, left, right);
     }
     else
     {
@@ -124,147 +236,354 @@ Interval<int64_t> evalArithmeticExpr(const ASTNode &node, const Store& store)
 }
 
 
-Interval<int64_t> evalLogicalExpr(const ASTNode &node, const Store& store)
+// Known bits of an arithmetic expression, the operations without a bitwise
+// transfer function fall back on the bits shared by their interval.
+KnownBits evalKnownBits(const ASTNode &node, const Store& store)
 {
-    if (node.type != NodeType::LOGIC_OP)
+    if (node.type == NodeType::INTEGER)
+        return KnownBits::constant(std::get<int>(node.value));
+    if (node.type == NodeType::VARIABLE)
+        return store.get_bits(std::get<std::string>(node.value));
+    if (node.type == NodeType::LOGIC_OP)
+        return KnownBits::from_interval(evalIntervalExpr(node, store));
+    if (node.type != NodeType::ARITHM_OP || node.children.size() != 2)
+        return KnownBits::top();
+
+    BinOp op = get_binop(node);
+    if (op == BinOp::DIV || op == BinOp::MOD)
+        return KnownBits::from_interval(evalIntervalExpr(node, store));
+    KnownBits left = evalKnownBits(node.children[0], store);
+    switch (op)
     {
-        throw std::runtime_error("Expected logical operation");
+        case BinOp::SHL: return left.shift(evalIntervalExpr(node.children[1], store), true);
+        case BinOp::SHR: return left.shift(evalIntervalExpr(node.children[1], store), false);
+        default: break;
     }
+    KnownBits right = evalKnownBits(node.children[1], store);
+    switch (op)
+    {
+        case BinOp::ADD: return left + right;
+        case BinOp::SUB: return left - right;
+        case BinOp::MUL: return left * right;
+        case BinOp::AND: return left & right;
+        case BinOp::OR: return left | right;
+        case BinOp::XOR: return left ^ right;
+        default: return KnownBits::top();
+    }
+}
 
-    auto left = evalArithmeticExpr(node.children[0], store);
-    auto right = evalArithmeticExpr(node.children[1], store);
-    LogicOp op = std::get<LogicOp>(node.value);
-
-    int32_t left_lower = static_cast<int32_t>(left.getLower() == std::numeric_limits<int64_t>::lowest() ? std::numeric_limits<int32_t>::lowest() : left.getLower());
-    int32_t right_lower = static_cast<int32_t>(right.getLower() == std::numeric_limits<int64_t>::lowest() ? std::numeric_limits<int32_t>::lowest() : right.getLower());
-    int32_t left_upper = static_cast<int32_t>(left.getUpper() == std::numeric_limits<int64_t>::max() ? std::numeric_limits<int32_t>::max() : left.getUpper());
-    int32_t right_upper = static_cast<int32_t>(right.getUpper() == std::numeric_limits<int64_t>::max() ? std::numeric_limits<int32_t>::max() : right.getUpper());
-
-    Interval<int64_t> result;
+bool has_bitwise_op(const ASTNode &node)
+{
+    if (node.type != NodeType::ARITHM_OP) return false;
+    BinOp op = get_binop(node);
+    if (op == BinOp::AND || op == BinOp::OR || op == BinOp::XOR || op == BinOp::SHL || op == BinOp::SHR) return true;
+    for (const auto &child : node.children)
+        if (has_bitwise_op(child)) return true;
+    return false;
+}
 
-    // print the intervals
-    std::cout << "Left: [" << left_lower << ", " << left_upper << "]" << std::endl;
-    std::cout << "Right: [" << right_lower << ", " << right_upper << "]" << std::endl;
+bool same_expr(const ASTNode &a, const ASTNode &b)
+{
+    if (a.type != b.type || a.value != b.value || a.children.size() != b.children.size()) return false;
+    for (size_t i = 0; i < a.children.size(); ++i)
+        if (!same_expr(a.children[i], b.children[i])) return false;
+    return true;
+}
 
-    switch (op)
+// Linearization of an arithmetic expression into a quasi-linear form: non-linear
+// products are intervalized on one side, and divisions either cancel
+// symbolically ((e * f) / f = e when f cannot be 0, (k * e) / k = e) or are
+// intervalized.
+QuasiLinearForm<int64_t> linearize(const ASTNode &node, const Store& store)
+{
+    using Form = QuasiLinearForm<int64_t>;
+    if (node.type == NodeType::INTEGER)
     {
-    case LogicOp::EQ:
-        // Return the intersection of the intervals
-        result = Interval<int64_t>(
-            std::max(left_lower, right_lower),
-            std::min(left_upper, right_upper)
-        );
-        break;
+        int64_t value = std::get<int>(node.value);
+        return Form(Interval<int64_t>(value, value));
+    }
+    else if (node.type == NodeType::VARIABLE)
+    {
+        return Form(std::get<std::string>(node.value));
+    }
+    else if (node.type == NodeType::ARRAY_ACCESS || node.type == NodeType::LOGIC_OP)
+    {
+        return Form(evalIntervalExpr(node, store));
+    }
+    else if (node.type != NodeType::ARITHM_OP || node.children.size() != 2)
+    {
+        return Form(Interval<int64_t>());
+    }
 
-    case LogicOp::NEQ:
+    const ASTNode &lhs = node.children[0], &rhs = node.children[1];
+    switch (get_binop(node))
+    {
+        case BinOp::ADD:
+            return linearize(lhs, store) + linearize(rhs, store);
+        case BinOp::SUB:
+            return linearize(lhs, store) - linearize(rhs, store);
+        case BinOp::MUL:
         {
-            Interval<int64_t> intersection(
-                std::max(left_lower, right_lower),
-                std::min(left_upper, right_upper)
-            );
-
-            // If the intervals overlap by exactly one value and that value equals
-            // the entire left interval, return empty; otherwise keep the left interval.
-            if (intersection.getLower() == intersection.getUpper() &&
-                left.getLower() == left.getUpper() &&
-                intersection.getLower() == left.getLower())
-            {
-                result = Interval<int64_t>::build_empty();
-            }
-            else
+            Form left = linearize(lhs, store), right = linearize(rhs, store);
+            if (right.is_constant()) return left.scale(right.get_constant());
+            if (left.is_constant()) return right.scale(left.get_constant());
+            return right.scale(left.evaluate(store));
+        }
+        case BinOp::DIV:
+        {
+            Form right = linearize(rhs, store);
+            Interval<int64_t> divisor = right.evaluate(store);
+            if (!divisor.contains(0) && lhs.type == NodeType::ARITHM_OP && lhs.children.size() == 2 && get_binop(lhs) == BinOp::MUL)
             {
-                // If there's more than one point to exclude (would split the interval),
-                // or no overlap, just keep the original left interval as an approximation.
-                result = left;
+                if (same_expr(lhs.children[1], rhs)) return linearize(lhs.children[0], store);
+                if (same_expr(lhs.children[0], rhs)) return linearize(lhs.children[1], store);
             }
+            Form left = linearize(lhs, store), quotient;
+            if (right.is_constant() && divisor.getLower() == divisor.getUpper() && left.divide_exact(divisor.getLower(), quotient))
+                return quotient;
+            if (divisor.contains(0)) return Form(Interval<int64_t>());
+            return Form(left.evaluate(store) / divisor);
         }
-        break;
+        default:
+            return Form(Interval<int64_t>());
+    }
+}
 
-    case LogicOp::LE:
-        // x < y: Return all x values that are less than the maximum y
-        result = Interval<int64_t>(
-            left_lower,
-            left_upper < right_upper ? left_upper : right_upper - 1
-        );
-        break;
+// Evaluates node both directly and through its linearization, both are sound so
+// their meet is kept.
+Interval<int64_t> evalArithmeticExpr(const ASTNode &node, const Store& store)
+{
+    Interval<int64_t> direct = evalIntervalExpr(node, store);
+    if (node.type != NodeType::ARITHM_OP) return direct;
+    return direct.meet(linearize(node, store).evaluate(store));
+}
 
-    case LogicOp::LEQ:
-        // x <= y: Return all x values that are less than or equal to the maximum y
-        result = Interval<int64_t>(
-            left_lower,
-            left_upper < right_upper ? left_upper : right_upper
-        );
-        break;
 
-    case LogicOp::GE:
-        // x > y: Return all x values that are greater than the minimum y
-        result = Interval<int64_t>(
-            left_lower > right_lower ? left_lower : right_lower + 1,
-            left_upper
-        );
-        break;
+Interval<int64_t> evalLogicalExpr(const ASTNode &node, const Store& store)
+{
+    if (node.type != NodeType::LOGIC_OP)
+    {
+        throw std::runtime_error("Expected logical operation");
+    }
 
-    case LogicOp::GEQ:
-        // x >= y: Return all x values that are greater than or equal to the minimum y
-        result = Interval<int64_t>(
-            left_lower > right_lower ? left_lower : right_lower,
-            left_upper
-        );
-        break;
+    auto left = evalArithmeticExpr(node.children[0], store);
+    auto right = evalArithmeticExpr(node.children[1], store);
+    LogicOp op = std::get<LogicOp>(node.value);
 
-    default:
-        throw std::runtime_error("Unsupported logical operation");
-    }
+    // print the intervals
+    report_out() << "Left: [" << comparison_lower(left) << ", " << comparison_upper(left) << "]" << std::endl;
+    report_out() << "Right: [" << comparison_lower(right) << ", " << comparison_upper(right) << "]" << std::endl;
 
-    return result;
+    return interval_comparison(op, left, right);
 }
 
+// A program point. Its store is computed by `transfer` from the stores it
+// depends on, `deps`; the solvers only differ in where they read those from.
 class location {
 public:
     Store store;
     std::vector<const Store*> deps;
+    // A location starts unreachable, the solvers bring its store up from the
+    // inputs; only the declarations are given their store.
+    explicit location(const std::vector<const Store*> &deps) : store(Store::bottom()), deps(deps) {}
     location(const Store &store, const std::vector<const Store*> &deps) : store(store), deps(deps) {}
-    virtual bool eval() = 0;
+
+    // Variables live after the location, when the dead ones are pruned.
+    std::optional<std::set<std::string>> live;
+
+    // Offset in the source of the statement it belongs to (ASTNode::offset).
+    size_t offset = std::string::npos;
+
+    // The new store of the location from `inputs`, one per dependency.
+    virtual Store transfer(const std::vector<const Store*> &inputs) = 0;
+
+    // The expressions evaluated on the inputs, for check_bounds.
+    virtual std::vector<const ASTNode*> expressions() const { return {}; }
+
+    // Liveness: the variables read from one of the inputs when `live_after`
+    // are live after the location.
+    virtual std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const { return live_after; }
+
+    // The store computed by `transfer`, without the dead variables. Nothing
+    // reaches a location that only unreachable locations lead to.
+    Store output(const std::vector<const Store*> &inputs) {
+        if (!inputs.empty() && std::all_of(inputs.begin(), inputs.end(), [](const Store *input) { return input->is_bottom(); }))
+            return Store::bottom();
+        Store new_store = transfer(inputs);
+        prune(new_store);
+        return new_store;
+    }
+
+    void prune(Store &s) const {
+        if (!live) return;
+        for (const auto &var : s.get_variables())
+            if (live->count(var) == 0) s.remove_variable(var);
+        for (const auto &var : s.get_arrays())
+            if (live->count(var) == 0) s.remove_variable(var);
+    }
+
+    // Returns true when the store did not change.
+    bool eval() {
+        Store new_store = output(deps);
+        bool changed = (store == new_store);
+        store = std::move(new_store);
+        return changed;
+    }
+
+    // As eval, calling changed(old store, new store) when the store changes.
+    template <typename Changed>
+    bool eval(Changed changed) {
+        Store new_store = output(deps);
+        bool unchanged = (store == new_store);
+        if (!unchanged) changed(store, new_store);
+        store = std::move(new_store);
+        return unchanged;
+    }
+
     virtual ~location() = default;
 };
 
 class declaration_location : public location {
 public:
     declaration_location(const Store &store, const std::vector<const Store*> &deps) : location(store, deps) {}
-    bool eval() override { std::cout << "Evaluating declaration" << std::endl; return true; }
+    Store transfer(const std::vector<const Store*> &) override { report_out() << "Evaluating declaration" << std::endl; return store; }
+};
+
+// Declaration inside a block: the variables enter the store, at top or at
+// their initializer, every time the declaration is reached.
+class local_declaration_location : public location {
+    const ASTNode &node;
+    size_t array_segments;
+public:
+    local_declaration_location(const ASTNode &node, const std::vector<const Store*> &deps, size_t array_segments = 1)
+        : location(deps), node(node), array_segments(array_segments) {}
+
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
+        if (node.type == NodeType::ARRAY_DECL) {
+            new_store.declare_array(std::get<std::string>(node.value), std::get<int>(node.children[0].value), array_segments);
+            return new_store;
+        }
+        std::string var;
+        for (const auto &child : node.children) {
+            if (child.type == NodeType::VARIABLE) {
+                var = std::get<std::string>(child.value);
+                new_store.update_interval(var, Interval<int64_t>());
+            }
+            else if (child.type == NodeType::INTEGER) {
+                int64_t value = std::get<int>(child.value);
+                new_store.update_interval(var, Interval<int64_t>(value, value));
+            }
+        }
+        return new_store;
+    }
+
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = live_after;
+        if (node.type == NodeType::ARRAY_DECL) needed.erase(std::get<std::string>(node.value));
+        for (const auto &child : node.children)
+            if (child.type == NodeType::VARIABLE) needed.erase(std::get<std::string>(child.value));
+        return needed;
+    }
+};
+
+// End of a block: its variables leave the store. A variable that shadowed an
+// outer one gives it back the value it had at the declaration, which the
+// block cannot have changed. deps = {end of the block, store before each
+// declaration}.
+class scope_exit_location : public location {
+    std::vector<std::pair<std::string, size_t>> declared;  // variable -> dep before its declaration
+public:
+    scope_exit_location(const std::vector<std::pair<std::string, size_t>> &declared, const std::vector<const Store*> &deps)
+        : location(deps), declared(declared) {}
+
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
+        for (const auto &[var, before] : declared) {
+            new_store.remove_variable(var);
+            if (inputs[before]->has_variable(var)) new_store.update_interval(var, inputs[before]->get_interval(var));
+            else if (inputs[before]->has_array(var)) new_store.set_array(var, inputs[before]->get_array(var));
+        }
+        return new_store;
+    }
+
+    // The block end only gives the variables of the outer scope, the stores
+    // before the declarations the shadowed variables still live.
+    std::set<std::string> live_before(size_t input, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = input == 0 ? live_after : std::set<std::string>{};
+        for (const auto &[var, before] : declared) {
+            if (input == 0) needed.erase(var);
+            else if (before == input && live_after.count(var)) needed.insert(var);
+        }
+        return needed;
+    }
 };
 
 class assignment_location : public location {
     const ASTNode& node;
 public:
-    assignment_location(const ASTNode& node, const Store &store, const std::vector<const Store*> &deps)
-        : location(store, deps), node(node) {}
+    assignment_location(const ASTNode& node, const std::vector<const Store*> &deps)
+        : location(deps), node(node) {}
 
-    bool eval() override { 
+    Store transfer(const std::vector<const Store*> &inputs) override {
         std::string var = std::get<std::string>(node.children[0].value);
-        Interval<int64_t> value = evalArithmeticExpr(node.children[1], *(deps[0]));
-        std::cout << "Evaluating assignment: " << var << " = [" << value.getLower() << ", " << value.getUpper() << "]" << std::endl;
-        auto new_store = assignment_eq(var, value);
-        bool changed = (store == new_store);
-        store = new_store;
-        return changed; 
+        Interval<int64_t> value = evalArithmeticExpr(node.children[1], *(inputs[0]));
+        report_out() << "Evaluating assignment: " << var << " = [" << value.getLower() << ", " << value.getUpper() << "]" << std::endl;
+        if (node.children[0].type == NodeType::ARRAY_ACCESS) {
+            Store new_store = *(inputs[0]);
+            new_store.write_array(var, evalArithmeticExpr(node.children[0].children[0], *(inputs[0])), value);
+            return new_store;
+        }
+        return node.children[1].type == NodeType::VARIABLE
+            ? copy_eq(*(inputs[0]), var, std::get<std::string>(node.children[1].value))
+            : assignment_eq(*(inputs[0]), var, value);
+    }
+
+    Store assignment_eq (const Store &input, const std::string &var, const Interval<int64_t> &value) {
+        Store new_store = input;
+        AffineExpr expr;
+        if (new_store.has_affine_equalities() && to_affine_expr(node.children[1], expr))
+            new_store.assign_affine(var, expr, value);
+        else
+            new_store.update_interval(var, value);
+        if (has_bitwise_op(node.children[1]) || input.has_known_bits())
+            new_store.update_bits(var, evalKnownBits(node.children[1], input));
+        return new_store;
     }
 
-    Store assignment_eq (const std::string &var, const Interval<int64_t> &value) {
-        Store new_store = *(deps[0]);
-        new_store.update_interval(var, value);
+    // `var = src` keeps track of the equality between the two variables.
+    Store copy_eq (const Store &input, const std::string &var, const std::string &src) {
+        Store new_store = input;
+        new_store.assign_variable(var, src);
         return new_store;
     }
+
+    // A dead variable assigned does not need the operands (strong liveness),
+    // unless they index an array: check_bounds evaluates every access. An
+    // array element write keeps the other elements, the array stays live.
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::string var = std::get<std::string>(node.children[0].value);
+        if (live_after.count(var) == 0 && !has_array_access(node)) return live_after;
+        std::set<std::string> needed = live_after;
+        if (node.children[0].type == NodeType::ARRAY_ACCESS) collect_variables(node.children[0], needed);
+        else needed.erase(var);
+        collect_variables(node.children[1], needed);
+        return needed;
+    }
+
+    std::vector<const ASTNode*> expressions() const override { return {&node}; }
+
+    const ASTNode &get_node() const { return node; }
 };
 
 class precondition_location : public location {
     const ASTNode &node;
 public:
-    precondition_location(const ASTNode &node, const Store &store, const std::vector<const Store*> &deps)
-        : location(store, deps), node(node) {}
+    precondition_location(const ASTNode &node, const std::vector<const Store*> &deps)
+        : location(deps), node(node) {}
 
-    bool eval() override {
-        Store new_store = *(deps[0]);
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
         if (node.children.size() != 2) {
             throw std::runtime_error("Invalid precondition");
         }
@@ -272,113 +591,307 @@ public:
         int64_t lb = std::get<int>(node.children[0].children[0].value);
         int64_t ub = std::get<int>(node.children[1].children[0].value);
         new_store.update_interval(var, Interval<int64_t>(lb, ub));
-        bool changed = (store == new_store);
-        store = new_store;
-        return changed;
+        return new_store;
+    }
+
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = live_after;
+        needed.erase(std::get<std::string>(node.children[0].children[1].value));
+        return needed;
     }
+
+    const ASTNode &get_node() const { return node; }
 };
 
 class preif_location : public location {
     const ASTNode &node;
     const std::string var;
-    const ASTNode logic_node;
+    const ASTNode &logic_node;
 public:
-    preif_location(const ASTNode &logic_node, const std::string &var, const ASTNode &node, const Store &store, const std::vector<const Store*> &deps) 
-        : location(store, deps), logic_node(logic_node), var(var), node(node) {}
+    preif_location(const ASTNode &logic_node, const std::string &var, const ASTNode &node, const std::vector<const Store*> &deps)
+        : location(deps), logic_node(logic_node), var(var), node(node) {}
 
-    bool eval() override {
-        Store new_store = *(deps[0]);
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
 
         // new_store.update_interval(var, evalLogicalExpr(logic_node, new_store)); 
-        new_store.update_interval(var, evalLogicalExpr(logic_node, new_store).meet(new_store.get_interval(var)));
+        if (!var.empty()) new_store.refine_interval(var, evalLogicalExpr(logic_node, new_store));
 
-        bool changed = (store == new_store);
-        store = new_store;
-        return changed;
+        return new_store;
+    }
+
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = live_after;
+        collect_variables(logic_node, needed);
+        return needed;
     }
+
+    std::vector<const ASTNode*> expressions() const override { return {&logic_node}; }
+
+    const std::string &get_var() const { return var; }
+    const ASTNode &get_guard() const { return logic_node; }
 };
 
+// One comparison of a compound guard, after the ones short-circuit evaluation
+// ran before it: refines its variable, and the store is unreachable when the
+// comparison cannot hold.
+class condition_location : public location {
+    const ASTNode &logic_node;
+    std::string var;
+public:
+    condition_location(const ASTNode &logic_node, const std::vector<const Store*> &deps)
+        : location(deps), logic_node(logic_node) {
+            if (logic_node.children[0].type == NodeType::VARIABLE) var = std::get<std::string>(logic_node.children[0].value);
+        }
+
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
+        if (var.empty()) return new_store;
+        new_store.refine_interval(var, evalLogicalExpr(logic_node, new_store));
+        if (new_store.get_interval(var).isEmpty()) return Store::bottom();
+        return new_store;
+    }
+
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = live_after;
+        collect_variables(logic_node, needed);
+        return needed;
+    }
+
+    std::vector<const ASTNode*> expressions() const override { return {&logic_node}; }
+
+    const std::string &get_var() const { return var; }
+    const ASTNode &get_guard() const { return logic_node; }
+};
+
+// Join of the ends of the two branches, deps = {if end, else end}.
 class ifelse_location : public location {
-std::shared_ptr<location> iflocation;
-std::shared_ptr<location> elselocation;
 public:
-    ifelse_location (std::shared_ptr<location>& iflocation, std::shared_ptr<location>& elselocation, const Store &store, const std::vector<const Store*> &deps) : location(store, deps), iflocation(iflocation), elselocation(elselocation) {}
-    bool eval() {
-        Store new_store = iflocation->store.join(elselocation->store);
-        bool changed = (store == new_store);
-        store = new_store;
-        return changed;
+    ifelse_location (std::shared_ptr<location>& iflocation, std::shared_ptr<location>& elselocation)
+        : location(std::vector<const Store*>{&(iflocation->store), &(elselocation->store)}) {}
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        return inputs[0]->join(*(inputs[1]));
+    }
+};
+
+// Join of its inputs: the stores leaving a loop (the exit of its guard, then
+// the breaks), or the ones where a compound guard holds or fails.
+class join_location : public location {
+public:
+    explicit join_location(const std::vector<const Store*> &deps) : location(deps) {}
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
+        for (size_t p = 1; p < inputs.size(); ++p) new_store = new_store.join(*(inputs[p]));
+        return new_store;
     }
 };
 
+// `break` or `continue`: the store before it goes to the loop exit or head,
+// and the statements after it are unreachable.
+class jump_location : public location {
+public:
+    explicit jump_location(const std::vector<const Store*> &deps) : location(deps) {}
+    Store transfer(const std::vector<const Store*> &) override { return Store::bottom(); }
+    std::set<std::string> live_before(size_t, const std::set<std::string> &) const override { return {}; }
+};
+
 class prewhile_location : public location {
     const ASTNode &node;
     const std::string var;
-    const ASTNode logic_node;
-    bool first = true;
+    const ASTNode &logic_node;
+    std::set<std::string> guard_vars;
+    // Bounds of the comparisons of a compound guard, see add_guard_thresholds.
+    std::map<std::string, std::vector<int64_t>> guard_thresholds;
+    LoopSettings settings;
+    std::optional<CountedLoop> counted;
+    uint32_t evaluations = 0;
+    uint32_t updates = 0;
+    uint32_t settled = 0;   // evaluations in a row that left the guard variables unchanged
 public:
-    Store *postwhile_store;
-
-    prewhile_location(const ASTNode &logic_node, const std::string &var, const ASTNode &node, const Store &store, const std::vector<const Store*> &deps)
-        : location(store, deps), logic_node(logic_node), var(var), node(node) {}
-    bool eval() override {
-        Store new_store = *(deps[0]);
+    // deps = {entry}, then {entry, end of the body, continues...} once the body is created.
+    prewhile_location(const ASTNode &logic_node, const std::string &var, const ASTNode &node, const std::vector<const Store*> &deps, const LoopSettings &settings = LoopSettings(), const std::optional<CountedLoop> &counted = std::nullopt)
+        : location(deps), logic_node(logic_node), var(var), node(node), settings(settings), counted(counted) {
+            collect_variables(logic_node, guard_vars);
+            if (logic_node.type == NodeType::BOOL_OP) add_guard_thresholds(logic_node);
+        }
 
-        if (first) first = false;
-        else new_store = new_store.join(*postwhile_store);
+    // The head of a compound guard is not refined by it (the loop exits from
+    // there), so the variables compared to a constant widen to that constant
+    // first instead of jumping to +/-oo.
+    void add_guard_thresholds(const ASTNode &guard) {
+        for (const auto &child : guard.children) add_guard_thresholds(child);
+        if (guard.type != NodeType::LOGIC_OP || guard.children[0].type != NodeType::VARIABLE || guard.children[1].type != NodeType::INTEGER) return;
+        int64_t bound = std::get<int>(guard.children[1].value);
+        auto &thresholds = guard_thresholds[std::get<std::string>(guard.children[0].value)];
+        thresholds.insert(thresholds.end(), {bound - 1, bound, bound + 1});
+    }
 
-        // Widening
+    // A compound guard (&&, ||) is split after the head, which only joins and widens.
+    // The back edges are unreachable until the body is first evaluated.
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
+        for (size_t p = 1; p < inputs.size(); ++p) new_store = new_store.join(*(inputs[p]));
+
+        // Widening, to the closest threshold before +/-oo. An unreachable head
+        // has no previous iterate to widen. The other variables wait for the
+        // guard variables to settle: those computed from them settle next,
+        // the ones still growing then accumulate and are widened.
+        if (evaluations++ > settings.widening_delay && !store.is_bottom())
         {
-            Interval<int64_t> old_iv = store.get_interval(var);
-            Interval<int64_t> joined_iv = new_store.get_interval(var);
-            int64_t widened_lower = (old_iv.getLower() > joined_iv.getLower()) ? std::numeric_limits<int64_t>::lowest() : old_iv.getLower();
-            int64_t widened_upper = (old_iv.getUpper() < joined_iv.getUpper()) ? std::numeric_limits<int64_t>::max() : old_iv.getUpper();
-            new_store.update_interval(var, Interval<int64_t>(widened_lower, widened_upper));
+            if (settled > settings.widening_delay) {
+                for (const auto &v : store.get_variables())
+                    if (guard_vars.count(v) == 0 && !(counted && counted->accelerates(v)) && new_store.has_variable(v))
+                        new_store.widen_interval(v, widen_to_thresholds(store.get_interval(v), new_store.get_interval(v), var_thresholds(v), true));
+            }
+            new_store.widen_arrays(store);
+            if (!counted) {
+                for (const auto &v : guard_vars)
+                    if (new_store.has_variable(v)) new_store.widen_interval(v, widen_to_thresholds(store.get_interval(v), new_store.get_interval(v), guard_var_thresholds(v), true));
+            }
         }
 
-        new_store.update_interval(
-            var,
-            evalLogicalExpr(logic_node, new_store).meet(new_store.get_interval(var))
-        );
+        // A counted loop needs neither: its inductions have a closed form.
+        if (counted) counted->accelerate_head(*(inputs[0]), new_store);
+        if (new_store.is_bottom()) return new_store;
 
-        bool changed = (store == new_store);
-        store = new_store;
-        return changed;
-        }
+        if (!var.empty() && logic_node.type == NodeType::LOGIC_OP) new_store.refine_interval(var, evalLogicalExpr(logic_node, new_store));
 
+        bool unchanged = !store.is_bottom();
+        for (const auto &v : guard_vars) unchanged = unchanged && store.get_interval(v) == new_store.get_interval(v);
+        settled = unchanged ? settled + 1 : 0;
+        if (!(store == new_store)) updates++;
+        return new_store;
+    }
+
+    // Both the entry and the back edge give the variables live in the loop.
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = live_after;
+        collect_variables(logic_node, needed);
+        return needed;
+    }
+
+    std::vector<const ASTNode*> expressions() const override {
+        if (logic_node.type != NodeType::LOGIC_OP) return {};
+        return {&logic_node};
+    }
+
+    // The thresholds of the profile for a variable.
+    std::vector<int64_t> var_thresholds(const std::string &v) const {
+        auto it = settings.thresholds.find(v);
+        return it != settings.thresholds.end() ? it->second : std::vector<int64_t>();
+    }
+
+    // The thresholds of a variable of the guard: the ones of the profile,
+    // then the bounds of the comparisons of a compound guard.
+    std::vector<int64_t> guard_var_thresholds(const std::string &v) const {
+        std::vector<int64_t> thresholds = var_thresholds(v);
+        auto bounds = guard_thresholds.find(v);
+        if (bounds != guard_thresholds.end()) thresholds.insert(thresholds.end(), bounds->second.begin(), bounds->second.end());
+        return thresholds;
+    }
+
+    uint32_t get_updates() const { return updates; }
+    const LoopSettings &get_settings() const { return settings; }
+    const std::string &get_var() const { return var; }
+    const ASTNode &get_guard() const { return logic_node; }
+    const std::set<std::string> &get_guard_vars() const { return guard_vars; }
+    const std::optional<CountedLoop> &get_counted() const { return counted; }
 };
 
 class postwhile_location : public location {
     const ASTNode &node;
     const std::string var;
-    ASTNode logic_node;
+    const ASTNode &logic_node;    // the negated guard
+    std::optional<CountedLoop> counted;
 public:
 
-    postwhile_location(const ASTNode &logic_node, const std::string &var, const ASTNode &node, const Store &store, const std::vector<const Store*> &deps)
-        : location(store, deps), logic_node(logic_node), var(var), node(node) {
-            // negate the logic node
-            this->logic_node.value = negate_logic_op(std::get<LogicOp>(logic_node.value));
-        }
+    postwhile_location(const ASTNode &logic_node, const std::string &var, const ASTNode &node, const std::vector<const Store*> &deps, const std::optional<CountedLoop> &counted = std::nullopt)
+        : location(deps), logic_node(logic_node), var(var), node(node), counted(counted) {}
 
-    bool eval() override {
-        Store new_store = *(deps[0]);
+    // deps = {end of the body, continues..., entry}.
+    Store transfer(const std::vector<const Store*> &inputs) override {
+        Store new_store = *(inputs[0]);
+        for (size_t p = 1; p + 1 < inputs.size(); ++p) new_store = new_store.join(*(inputs[p]));
 
-        std::cout << "Logical expression: " << std::get<LogicOp>(logic_node.value) << std::endl;
+        report_out() << "Logical expression: " << std::get<LogicOp>(logic_node.value) << std::endl;
 
-        std::cout << "prestore: " << std::endl;
+        report_out() << "prestore: " << std::endl;
         new_store.print();
 
-        new_store.update_interval(var, evalLogicalExpr(logic_node, new_store).meet(new_store.get_interval(var)));
+        // The entries failing the guard skip the body.
+        const Store &entry = *(inputs.back());
+        Store skipped = entry;
+        if (!var.empty()) {
+            new_store.refine_interval(var, evalLogicalExpr(logic_node, new_store));
+            skipped.refine_interval(var, evalLogicalExpr(logic_node, skipped));
+        }
+        if (var.empty() || !skipped.get_interval(var).isEmpty()) new_store = new_store.join(skipped);
+
+        if (counted) {
+            counted->accelerate_exit(entry, new_store);
+            Interval<int64_t> trips = counted->trip_count(entry.get_interval(var));
+            report_out() << "Counted loop on " << var << ": [" << trips.getLower() << ", " << trips.getUpper() << "] iterations" << std::endl;
+        }
 
-        std::cout << "poststore: " << std::endl;
+        report_out() << "poststore: " << std::endl;
         new_store.print();
 
-        bool changed = (store == new_store);
-        store = new_store;
-        return changed;
+        return new_store;
+    }
+
+    std::set<std::string> live_before(size_t, const std::set<std::string> &live_after) const override {
+        std::set<std::string> needed = live_after;
+        collect_variables(logic_node, needed);
+        return needed;
     }
+
+    std::vector<const ASTNode*> expressions() const override { return {&logic_node}; }
+
+    const std::string &get_var() const { return var; }
+    const ASTNode &get_guard() const { return logic_node; }
+    const std::optional<CountedLoop> &get_counted() const { return counted; }
 };
 
+// Location graph shared by the liveness analysis and the parallel solvers: for every location, the
+// locations whose store it reads (in the order of its deps) and the ones
+// reading its store.
+struct LocationGraph {
+    std::vector<std::vector<size_t>> inputs;
+    std::vector<std::vector<size_t>> dependents;
+
+    explicit LocationGraph(const std::vector<std::shared_ptr<location>>& locations)
+        : inputs(locations.size()), dependents(locations.size()) {
+        std::map<const Store*, size_t> owner;
+        for (size_t i = 0; i < locations.size(); ++i) owner[&(locations[i]->store)] = i;
+        for (size_t i = 0; i < locations.size(); ++i) {
+            for (const Store* dep : locations[i]->deps) {
+                size_t j = owner.at(dep);
+                inputs[i].push_back(j);
+                dependents[j].push_back(i);
+            }
+        }
+    }
+};
+
+// Backward liveness over the location graph: the variables live after every
+// location, `at_exit` being the ones live after the last one. The sets only
+// grow, the loops are iterated until they are stable.
+std::vector<std::set<std::string>> live_variables(const std::vector<std::shared_ptr<location>> &locations, const std::set<std::string> &at_exit)
+{
+    LocationGraph graph(locations);
+    std::vector<std::set<std::string>> live(locations.size());
+    if (!locations.empty()) live.back() = at_exit;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = locations.size(); i-- > 0;) {
+            for (size_t p = 0; p < graph.inputs[i].size(); ++p)
+                for (const auto &var : locations[i]->live_before(p, live[i]))
+                    changed = live[graph.inputs[i][p]].insert(var).second || changed;
+        }
+    }
+    return live;
+}
 
 class AbstractInterpreter
 {
@@ -387,121 +900,438 @@ private:
     std::vector<std::shared_ptr<location>> locations;
     bool end = false;
     uint32_t iteration = 0;
+    bool affine_equalities = false;
+    bool step = false;
+    bool prune_dead = false;
+    bool acceleration = true;
+    size_t array_segments = 8;
+    AnalysisProfile *profile = nullptr;
+    HistoryRecorder *history = nullptr;
+    std::function<std::string(size_t)> locator;
+    std::vector<std::pair<uint64_t, std::shared_ptr<prewhile_location>>> loop_heads;
+    // The guards rewritten for the locations (normalized, negated), which hold
+    // them by reference like the nodes of the AST: a deque does not move them.
+    std::deque<ASTNode> guards;
+
+    // Blocks and loops around the location being created.
+    struct Scope {
+        std::vector<std::pair<std::string, size_t>> declared;  // variable -> dep before its declaration
+        std::vector<const Store*> deps{nullptr};                // {end of the block, stores before the declarations}
+    };
+    struct Loop {
+        size_t scope_depth;                     // scopes outside the loop
+        std::vector<const Store*> breaks;       // stores before the breaks
+        std::vector<const Store*> continues;
+    };
+    std::vector<Scope> scopes;
+    std::vector<Loop> loops;
 
 public:
     AbstractInterpreter() = default;
 
-    void create_top_locations(const ASTNode& ast) {
-        locations.push_back(std::make_shared<declaration_location>(Store(), std::vector<const Store*>{}));
+    // Pairs the intervals with Karr's affine equalities in every store.
+    void enable_affine_equalities() { affine_equalities = true; }
+    bool has_affine_equalities() const { return affine_equalities; }
+
+    // Every store only keeps the variables live at its location: the ones the
+    // rest of the program reads before writing them, or that the assertions
+    // check. The final store only shows those.
+    void enable_liveness_pruning() { prune_dead = true; }
+    bool prunes_dead_variables() const { return prune_dead; }
+
+    // Counted loops are iterated like the others instead of taking their
+    // closed form (see counted_loop.hpp).
+    void disable_acceleration() { acceleration = false; }
+
+    // Every array is at most `segments` segments of one interval each
+    // (see array_domain.hpp); 1 smashes the elements together.
+    void set_array_segments(size_t segments) { array_segments = segments; }
+
+    // eval_all logs the delta of every store that changed into `h` (see
+    // iteration_history.hpp) instead of printing the stores.
+    void record_history(HistoryRecorder *h) { history = h; }
+
+    // Waits for a key press before every iteration of eval_all.
+    void enable_stepping() { step = true; }
+
+    // The alarms name their statement by `locate(offset)`, e.g. `file.c:12`
+    // (see ASTNode::offset).
+    void locate_statements(std::function<std::string(size_t)> locate) { locator = std::move(locate); }
+
+    // Loop heads take their widening settings from the profile, and record
+    // their iterations and bounds into it once the fixpoint is reached.
+    void use_profile(AnalysisProfile *p) { profile = p; }
+
+    void record_profile() const {
+        if (profile == nullptr) return;
+        for (const auto &[key, head] : loop_heads) {
+            LoopProfile loop;
+            loop.iterations = head->get_updates();
+            loop.widening_delay = head->get_settings().widening_delay;
+            for (const auto &var : head->store.get_variables()) {
+                Interval<int64_t> iv = head->store.get_interval(var);
+                loop.bounds[var] = {iv.getLower(), iv.getUpper()};
+            }
+            profile->record(key, loop);
+        }
+    }
+
+    // The declared variables start at top, or at their initializer. With an
+    // entry store (variables linked with other translation units), the
+    // variables it already holds keep their entry value.
+    void create_top_locations(const ASTNode& ast, const Store* entry = nullptr) {
+        locations.push_back(std::make_shared<declaration_location>(entry != nullptr ? *entry : Store(), std::vector<const Store*>{}));
+        if (affine_equalities && !locations[0]->store.has_affine_equalities()) locations[0]->store.enable_affine_equalities();
         for (const auto& top_level_child : ast.children) {
             if (top_level_child.type == NodeType::DECLARATION) {
+                std::string var;
                 for (const auto& child : top_level_child.children) {
-                    std::string var = std::get<std::string>(child.value);
-                    locations[0]->store.update_interval(var, Interval<int64_t>());
+                    if (child.type == NodeType::VARIABLE) {
+                        var = std::get<std::string>(child.value);
+                        if (entry == nullptr || !entry->has_variable(var))
+                            locations[0]->store.update_interval(var, Interval<int64_t>());
+                    }
+                    else if (child.type == NodeType::INTEGER && (entry == nullptr || !entry->has_variable(var))) {
+                        int64_t value = std::get<int>(child.value);
+                        locations[0]->store.update_interval(var, Interval<int64_t>(value, value));
+                    }
                 }
             }
+            else if (top_level_child.type == NodeType::ARRAY_DECL) {
+                std::string var = std::get<std::string>(top_level_child.value);
+                if (entry == nullptr || !entry->has_array(var))
+                    locations[0]->store.declare_array(var, std::get<int>(top_level_child.children[0].value), array_segments);
+            }
             else if (top_level_child.type == NodeType::SEQUENCE)
                 for (const auto& child : top_level_child.children) create_locations(child, locations.size() - 1);
             }
+        if (prune_dead) prune_dead_variables(ast);
+        }
+
+    // Same assertions as check_assertions.
+    void prune_dead_variables(const ASTNode& ast) {
+        std::set<std::string> asserted;
+        if (!ast.children.empty())
+            for (const auto &child : ast.children.back().children)
+                if (child.type == NodeType::POST_CON) collect_variables(child, asserted);
+        auto live = live_variables(locations, asserted);
+        for (size_t i = 0; i < locations.size(); ++i) {
+            locations[i]->live = std::move(live[i]);
+            locations[i]->prune(locations[i]->store);
+        }
+    }
+
+
+    // The guard as a comparison or a BOOL_OP of comparisons (normalize_guard),
+    // negated or not: the node of the AST itself when it already is one.
+    const ASTNode& guard_node(const ASTNode& guard, bool negated = false) {
+        if (guard.type == NodeType::LOGIC_OP && !negated) return guard;
+        guards.push_back(normalize_guard(guard, negated));
+        return guards.back();
+    }
+
+    // The variable a guard refines, "" when its left operand is not one.
+    static std::string guard_variable(const ASTNode& logic_node) {
+        if (logic_node.children.empty() || logic_node.children[0].type != NodeType::VARIABLE) return "";
+        return std::get<std::string>(logic_node.children[0].value);
+    }
+
+    // Short-circuit evaluation of a normalized compound guard from the store of
+    // the location i: one condition location per comparison, the right operand
+    // of && (||) only running where the left one holds (fails). Returns the
+    // locations where the guard holds, and the ones where it fails.
+    std::pair<std::vector<size_t>, std::vector<size_t>> split_guard(const ASTNode& guard, size_t i) {
+        if (guard.type != NodeType::BOOL_OP) {
+            locations.push_back(std::make_shared<condition_location>(guard, std::vector<const Store*>{&(locations[i]->store)}));
+            locations.push_back(std::make_shared<condition_location>(guard_node(guard, true), std::vector<const Store*>{&(locations[i]->store)}));
+            return {{locations.size() - 2}, {locations.size() - 1}};
+        }
+        bool conjunction = std::get<std::string>(guard.value) == "&&";
+        auto [holds, fails] = split_guard(guard.children[0], i);
+        std::vector<size_t> &undecided = conjunction ? holds : fails;
+        size_t next = undecided.size() == 1 ? undecided[0] : join_guard(undecided);
+        undecided.clear();
+        auto [right_holds, right_fails] = split_guard(guard.children[1], next);
+        holds.insert(holds.end(), right_holds.begin(), right_holds.end());
+        fails.insert(fails.end(), right_fails.begin(), right_fails.end());
+        return {holds, fails};
+    }
+
+    // Joins the stores of the locations `from`, returns the index of the join.
+    size_t join_guard(const std::vector<size_t>& from) {
+        std::vector<const Store*> deps;
+        for (size_t j : from) deps.push_back(&(locations[j]->store));
+        locations.push_back(std::make_shared<join_location>(deps));
+        return locations.size() - 1;
+    }
+
+    // A loop on a compound guard: the head joins and widens, the guard is split
+    // after it, and the loop exits where it fails.
+    void create_compound_loop(const ASTNode& ast, const ASTNode& logic_node, size_t i, uint64_t key, const LoopSettings& settings) {
+        auto head = std::make_shared<prewhile_location>(logic_node, "", ast.children[1].children[0], std::vector<const Store*>{&(locations[i]->store)}, settings);
+        loop_heads.emplace_back(key, head);
+        locations.push_back(head);
+        auto [holds, fails] = split_guard(logic_node, locations.size() - 1);
+        join_guard(holds);
+        loops.push_back(Loop{scopes.size(), {}, {}});
+        create_locations(ast.children[1].children[0], locations.size() - 1);
+        head->deps.push_back(&(locations.back()->store));
+        Loop loop = std::move(loops.back());
+        loops.pop_back();
+        for (const Store* store : loop.continues) head->deps.push_back(store);
+        join_guard(fails);
+        if (!loop.breaks.empty()) {
+            loop.breaks.insert(loop.breaks.begin(), &(locations.back()->store));
+            locations.push_back(std::make_shared<join_location>(loop.breaks));
         }
+    }
 
+    // Drops the variables of `scope` from the store of the location i,
+    // returns the index of the scope exit.
+    size_t exit_scope(const Scope &scope, size_t i) {
+        std::vector<const Store*> deps = scope.deps;
+        deps[0] = &(locations[i]->store);
+        locations.push_back(std::make_shared<scope_exit_location>(scope.declared, deps));
+        return locations.size() - 1;
+    }
 
+    // The locations of `ast` after the location i, each tagged with the
+    // offset of the innermost statement it belongs to.
     void create_locations(const ASTNode& ast, size_t i) {
+        size_t first = locations.size();
+        create_statement_locations(ast, i);
+        for (size_t k = first; k < locations.size(); ++k)
+            if (locations[k]->offset == std::string::npos) locations[k]->offset = ast.offset;
+    }
+
+    void create_statement_locations(const ASTNode& ast, size_t i) {
         if (ast.type == NodeType::ASSIGNMENT) {
             locations.push_back(std::make_shared<assignment_location>(
                 ast,
-                locations[i]->store, 
                 std::vector<const Store*>{&(locations[i]->store)}
             ));
         }
         else if (ast.type == NodeType::PRE_CON) {
             locations.push_back(std::make_shared<precondition_location>(
-                ast, 
-                locations[i]->store, 
+                ast,
                 std::vector<const Store*>{&(locations[i]->store)}
             ));
         }
         else if (ast.type == NodeType::IFELSE) {
-            Store if_store = locations[i]->store;
-
-            auto logic_node = ast.children[0].children[0];
+            const ASTNode &logic_node = guard_node(ast.children[0].children[0]);
+            if (logic_node.type == NodeType::BOOL_OP) {
+                auto [holds, fails] = split_guard(logic_node, i);
+                join_guard(holds);
+                create_locations(ast.children[1].children[0], locations.size() - 1);
+                auto iflocation = locations.back();
+                join_guard(fails);
+                if (ast.children.size() == 3)
+                    create_locations(ast.children[2].children[0], locations.size() - 1);
+                auto elselocation = locations.back();
+                locations.push_back(std::make_shared<ifelse_location>(iflocation, elselocation));
+                return;
+            }
 
-            auto variable_node = logic_node.children[0];
+            std::string var = guard_variable(logic_node);
 
-            locations.push_back(std::make_shared<preif_location>(logic_node, std::get<std::string>(variable_node.value), ast.children[1].children[0], if_store, std::vector<const Store*>{&(locations[i]->store)}));
+            locations.push_back(std::make_shared<preif_location>(logic_node, var, ast.children[1].children[0], std::vector<const Store*>{&(locations[i]->store)}));
             create_locations(ast.children[1].children[0], locations.size() - 1);
 
             auto iflocation = locations.back();
 
-            Store else_store = locations[i]->store;
-
-            if (ast.children.size() == 3) 
-                logic_node.value = negate_logic_op(std::get<LogicOp> (logic_node.value));
-            
-            if (ast.children.size() == 3)
-                locations.push_back(std::make_shared<preif_location>(logic_node, std::get<std::string>(variable_node.value), ast.children[2].children[0], else_store, std::vector<const Store*>{&(locations[i]->store)}));
+            // Without else, the else branch is the negated guard alone.
+            const ASTNode &else_body = ast.children.size() == 3 ? ast.children[2].children[0] : ast.children[1].children[0];
+            locations.push_back(std::make_shared<preif_location>(guard_node(logic_node, true), var, else_body, std::vector<const Store*>{&(locations[i]->store)}));
 
             if (ast.children.size() == 3) 
                 create_locations(ast.children[2].children[0], locations.size() - 1);
 
             auto elselocation = locations.back();
 
-            locations.push_back(std::make_shared<ifelse_location>(iflocation, elselocation, locations[i]->store, std::vector<const Store*>{}));
+            locations.push_back(std::make_shared<ifelse_location>(iflocation, elselocation));
 
         }
         else if (ast.type == NodeType::WHILELOOP){
-            Store while_store = locations[i]->store;
-            auto logic_node = ast.children[0].children[0];
-            auto variable_node = logic_node.children[0];
-            locations.push_back(std::make_shared<prewhile_location>(logic_node, std::get<std::string>(variable_node.value), ast.children[1].children[0], while_store, std::vector<const Store*>{&(locations[i]->store)}));
+            const ASTNode &logic_node = guard_node(ast.children[0].children[0]);
+            std::string var = guard_variable(logic_node);
+            uint64_t key = profile != nullptr ? profile->key_for(ast.hash()) : ast.hash();
+            LoopSettings settings = profile != nullptr ? profile->settings_for(key) : LoopSettings();
+            if (logic_node.type == NodeType::BOOL_OP) {
+                create_compound_loop(ast, logic_node, i, key, settings);
+                return;
+            }
+            std::optional<CountedLoop> counted;
+            if (acceleration) counted = CountedLoop::recognize(logic_node, ast.children[1].children[0]);
+            auto head = std::make_shared<prewhile_location>(logic_node, var, ast.children[1].children[0], std::vector<const Store*>{&(locations[i]->store)}, settings, counted);
+            loop_heads.emplace_back(key, head);
+            locations.push_back(head);
             auto whilelocation = locations.back();
+            loops.push_back(Loop{scopes.size(), {}, {}});
             create_locations(ast.children[1].children[0], locations.size() - 1);
             auto postwhile_store = locations.back();
-            std::dynamic_pointer_cast<prewhile_location>(whilelocation)->postwhile_store = &(postwhile_store->store);
-            locations.push_back(std::make_shared<postwhile_location>(logic_node, std::get<std::string>(variable_node.value), ast.children[1].children[0], while_store, std::vector<const Store*>{&(locations.back()->store)}));
+            whilelocation->deps.push_back(&(postwhile_store->store));
+            Loop loop = std::move(loops.back());
+            loops.pop_back();
+            for (const Store* store : loop.continues) whilelocation->deps.push_back(store);
+            std::vector<const Store*> exits{&(postwhile_store->store)};
+            exits.insert(exits.end(), loop.continues.begin(), loop.continues.end());
+            exits.push_back(&(locations[i]->store));
+            locations.push_back(std::make_shared<postwhile_location>(guard_node(logic_node, true), var, ast.children[1].children[0], exits, counted));
+            if (!loop.breaks.empty()) {
+                loop.breaks.insert(loop.breaks.begin(), &(locations.back()->store));
+                locations.push_back(std::make_shared<join_location>(loop.breaks));
+            }
 
         }
-        else if (ast.type == NodeType::SEQUENCE) for (const auto& child : ast.children) create_locations(child, locations.size() - 1);
-        else if (ast.type == NodeType::POST_CON) std::cout << "Post condition found" << std::endl;
-        else { std::cerr << "Unsupported node type" << ": " << ast.type << std::endl; std::cout << "Skipping..." << std::endl; ast.print(); }
+        else if (ast.type == NodeType::DECLARATION || ast.type == NodeType::ARRAY_DECL) {
+            locations.push_back(std::make_shared<local_declaration_location>(
+                ast,
+                std::vector<const Store*>{&(locations[i]->store)},
+                array_segments
+            ));
+        }
+        else if (ast.type == NodeType::SEQUENCE) {
+            // A block is a scope: the variables it declares are dropped at its end.
+            scopes.emplace_back();
+            for (const auto& child : ast.children) {
+                const Store* before = &(locations.back()->store);
+                create_locations(child, locations.size() - 1);
+                std::vector<std::string> names;
+                if (child.type == NodeType::ARRAY_DECL) names.push_back(std::get<std::string>(child.value));
+                else if (child.type == NodeType::DECLARATION)
+                    for (const auto& var : child.children)
+                        if (var.type == NodeType::VARIABLE) names.push_back(std::get<std::string>(var.value));
+                Scope &scope = scopes.back();
+                for (const auto& name : names) {
+                    bool redeclared = false;
+                    for (const auto& d : scope.declared) redeclared = redeclared || d.first == name;
+                    if (redeclared) continue;
+                    size_t dep = std::find(scope.deps.begin(), scope.deps.end(), before) - scope.deps.begin();
+                    if (dep == scope.deps.size()) scope.deps.push_back(before);
+                    scope.declared.emplace_back(name, dep);
+                }
+            }
+            Scope scope = std::move(scopes.back());
+            scopes.pop_back();
+            if (!scope.declared.empty()) exit_scope(scope, locations.size() - 1);
+        }
+        else if (ast.type == NodeType::BREAK || ast.type == NodeType::CONTINUE) {
+            if (loops.empty()) {
+                report_err() << "`" << std::get<std::string>(ast.value) << "` outside of a loop, ignored" << std::endl;
+                return;
+            }
+            // The blocks the jump leaves drop their variables first.
+            for (size_t s = scopes.size(); s-- > loops.back().scope_depth;)
+                if (!scopes[s].declared.empty()) i = exit_scope(scopes[s], i);
+            (ast.type == NodeType::BREAK ? loops.back().breaks : loops.back().continues).push_back(&(locations[i]->store));
+            locations.push_back(std::make_shared<jump_location>(std::vector<const Store*>{&(locations[i]->store)}));
+        }
+        else if (ast.type == NodeType::POST_CON) report_out() << "Post condition found" << std::endl;
+        else { report_err() << "Unsupported node type" << ": " << ast.type << std::endl; report_out() << "Skipping..." << std::endl; ast.print(); }
     }
 
     void eval_all(){
+        if (history != nullptr && iteration == 0) {
+            history->begin_iteration(-1);
+            for (size_t i = 0; i < locations.size(); ++i) history->record_store(i, locations[i]->store);
+        }
         while (!end){
-            std::cin.get();
-            std::cout << "Iteration " << iteration << std::endl;
+            if (step) std::cin.get();
+            report_out() << "Iteration " << iteration << std::endl;
+            if (history != nullptr) history->begin_iteration(iteration);
             end = true;
             for (size_t i = 0; i < locations.size(); ++i) {
-                std::cout << "Evaluating location " << i << "..." << std::endl;
                 auto &loc = locations[i];
+                if (history != nullptr) {
+                    // The log replaces the stores printed after every location.
+                    bool unchanged = loc->eval([&](const Store &before, const Store &after) { history->record_store(i, before, after); });
+                    end = unchanged && end;
+                    continue;
+                }
+                report_out() << "Evaluating location " << i << "..." << std::endl;
                 end = loc->eval() && end;
                 loc->store.print();
             }
             iteration++;
         }
-        std::cout << "Fixed point reached after " << iteration - 1 << " iterations" << std::endl;
+        report_out() << "Fixed point reached after " << iteration - 1 << " iterations" << std::endl;
+    }
+
+    // For the parallel solvers, see parallel_solver.hpp.
+    std::vector<std::shared_ptr<location>>& get_locations() { return locations; }
+
+    const Store& final_store() const {
+        return locations.back()->store;
+    }
+
+    // Moves the store of every location out, in location order; the
+    // interpreter is not to be evaluated again afterwards.
+    std::vector<Store> take_stores() {
+        std::vector<Store> stores;
+        stores.reserve(locations.size());
+        for (auto &loc : locations) stores.push_back(std::move(loc->store));
+        return stores;
     }
 
     void check_assertions(const ASTNode& ast){
-        if (locations.empty()){ std::cerr << "No locations to check assertions" << std::endl; return; }
-        Store store = locations.back()->store;
+        if (locations.empty()){ report_err() << "No locations to check assertions" << std::endl; return; }
+        check_bounds();
+        check_assertions(ast, locations.back()->store);
+    }
+
+    // Every array access of the fixpoint, against the stores it is evaluated
+    // on: an alarm for each one whose index may leave [0, N - 1]. Returns the
+    // alarms reported.
+    std::vector<std::string> check_bounds() const {
+        std::vector<std::string> alarms;
+        // A guard is held by both of its branches, or the head and the exit of
+        // its loop, which belong to the same statement: an access is told
+        // apart from the same one elsewhere by its statement.
+        std::set<std::tuple<size_t, uint64_t, int64_t, int64_t>> reported;
+        std::function<void(const ASTNode&, const Store&, size_t)> visit = [&](const ASTNode& node, const Store& store, size_t offset) {
+            for (const auto& child : node.children) visit(child, store, offset);
+            if (node.type != NodeType::ARRAY_ACCESS) return;
+            std::string var = std::get<std::string>(node.value);
+            if (!store.has_array(var)) return;
+            int64_t size = store.get_array(var).get_size();
+            Interval<int64_t> index = evalArithmeticExpr(node.children[0], store);
+            if (index.isEmpty() || (index.getLower() >= 0 && index.getUpper() < size)) return;
+            if (!reported.emplace(offset, node.hash(), index.getLower(), index.getUpper()).second) return;
+            std::string where = locator && offset != std::string::npos ? locator(offset) : "";
+            alarms.push_back("Array access might be out of bounds" + (where.empty() ? "" : " at " + where) + ": " + var + "[...] index in ["
+                             + std::to_string(index.getLower()) + ", " + std::to_string(index.getUpper()) + "], size " + std::to_string(size));
+            report_err() << alarms.back() << std::endl;
+            node.children[0].print();
+        };
+        for (const auto& loc : locations) {
+            auto expressions = loc->expressions();
+            if (expressions.empty() || loc->deps.empty()) continue;
+            Store input = *(loc->deps[0]);
+            for (size_t d = 1; d < loc->deps.size(); ++d) input = input.join(*(loc->deps[d]));
+            if (input.is_bottom()) continue;
+            for (const ASTNode* expr : expressions) visit(*expr, input, loc->offset);
+        }
+        return alarms;
+    }
+
+    void check_assertions(const ASTNode& ast, const Store& store) const {
         const auto &seq = ast.children.back();
         for (const auto &child : seq.children){
             if (child.type == NodeType::POST_CON){
                 const auto& assertion_interval = evalLogicalExpr(child.children[0], store);
                 if (assertion_interval.getLower() > assertion_interval.getUpper()){
-                    std::cerr << "Assertion might fail: " << std::endl;
+                    report_err() << "Assertion might fail: " << std::endl;
                     child.children[0].print();
-                    std::cout << "Current store state:" << std::endl;
+                    report_out() << "Current store state:" << std::endl;
                     store.print();
                 }
                 else
                 {
-                    std::cout << "Assertion verified successfully" << std::endl;
+                    report_out() << "Assertion verified successfully" << std::endl;
                 }
             }
         }
-        std::cout << "Final store state:" << std::endl;
+        report_out() << "Final store state:" << std::endl;
         store.print();
     }
 };
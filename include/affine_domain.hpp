@@ -0,0 +1,306 @@
+#ifndef AFFINE_DOMAIN_HPP
+#define AFFINE_DOMAIN_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "report.hpp"
+
+// Exact rational number, the coefficients of Karr's domain must not be rounded.
+// An arithmetic overflow throws std::overflow_error, the domain then goes to top.
+class Rational {
+private:
+    int64_t num;
+    int64_t den;
+
+    static int64_t narrow(__int128 v) {
+        if (v > std::numeric_limits<int64_t>::max() || v < -std::numeric_limits<int64_t>::max()) {
+            throw std::overflow_error("Rational overflow");
+        }
+        return static_cast<int64_t>(v);
+    }
+
+    static Rational make(__int128 n, __int128 d) {
+        if (d == 0) throw std::domain_error("Rational division by zero");
+        if (d < 0) { n = -n; d = -d; }
+        __int128 a = n < 0 ? -n : n, b = d;
+        while (b != 0) { __int128 t = a % b; a = b; b = t; }
+        if (a > 1) { n /= a; d /= a; }
+        Rational r;
+        r.num = narrow(n);
+        r.den = narrow(d);
+        return r;
+    }
+
+public:
+    Rational(int64_t n = 0) : num(n), den(1) {}
+
+    int64_t numerator() const { return num; }
+    int64_t denominator() const { return den; }
+    bool is_zero() const { return num == 0; }
+    long double to_long_double() const { return static_cast<long double>(num) / den; }
+
+    Rational operator+(const Rational& o) const { return make((__int128)num * o.den + (__int128)o.num * den, (__int128)den * o.den); }
+    Rational operator-(const Rational& o) const { return make((__int128)num * o.den - (__int128)o.num * den, (__int128)den * o.den); }
+    Rational operator*(const Rational& o) const { return make((__int128)num * o.num, (__int128)den * o.den); }
+    Rational operator/(const Rational& o) const { return make((__int128)num * o.den, (__int128)den * o.num); }
+    Rational operator-() const { return make(-(__int128)num, den); }
+
+    bool operator==(const Rational& o) const { return num == o.num && den == o.den; }
+    bool operator!=(const Rational& o) const { return !(*this == o); }
+
+    friend std::ostream& operator<<(std::ostream& os, const Rational& r) {
+        os << r.num;
+        if (r.den != 1) os << "/" << r.den;
+        return os;
+    }
+};
+
+// sum(coeffs[v] * v) + constant
+struct AffineExpr {
+    std::map<std::string, Rational> coeffs;
+    Rational constant;
+};
+
+// Karr's domain of affine equalities between variables.
+// The affine space is kept in generator form: a point plus a basis of directions
+// in reduced row echelon form. Joins and non-deterministic assignments only
+// insert new directions into the echelon basis (incremental Gaussian
+// elimination); the equalities are read off the basis without solving anything.
+class AffineEqualityDomain {
+private:
+    using Row = std::vector<Rational>;
+
+    std::vector<std::string> vars;
+    std::map<std::string, size_t> index;
+    Row point;
+    std::vector<Row> basis;       // sorted by pivot, pivot coefficient is 1
+    std::vector<size_t> pivots;
+
+    static size_t leading(const Row& row) {
+        for (size_t i = 0; i < row.size(); ++i) if (!row[i].is_zero()) return i;
+        return row.size();
+    }
+
+    size_t add_variable(const std::string& var) {
+        size_t col = vars.size();
+        vars.push_back(var);
+        index[var] = col;
+        point.push_back(Rational(0));
+        for (auto& row : basis) row.push_back(Rational(0));
+        // A fresh variable is unconstrained.
+        Row unit(vars.size(), Rational(0));
+        unit[col] = Rational(1);
+        insert_direction(unit);
+        return col;
+    }
+
+    size_t column(const std::string& var) {
+        auto it = index.find(var);
+        return it != index.end() ? it->second : add_variable(var);
+    }
+
+    // Incremental row echelon update: reduce `dir` by the basis and, if it is
+    // independent, eliminate its pivot from the other rows and the point.
+    void insert_direction(Row dir) {
+        for (size_t r = 0; r < basis.size(); ++r) {
+            Rational f = dir[pivots[r]];
+            if (f.is_zero()) continue;
+            for (size_t i = 0; i < dir.size(); ++i) dir[i] = dir[i] - f * basis[r][i];
+        }
+        size_t piv = leading(dir);
+        if (piv == dir.size()) return;
+        Rational lead = dir[piv];
+        for (auto& c : dir) c = c / lead;
+        for (auto& row : basis) {
+            Rational f = row[piv];
+            if (f.is_zero()) continue;
+            for (size_t i = 0; i < row.size(); ++i) row[i] = row[i] - f * dir[i];
+        }
+        Rational f = point[piv];
+        if (!f.is_zero()) {
+            for (size_t i = 0; i < point.size(); ++i) point[i] = point[i] - f * dir[i];
+        }
+        size_t pos = 0;
+        while (pos < pivots.size() && pivots[pos] < piv) ++pos;
+        basis.insert(basis.begin() + pos, dir);
+        pivots.insert(pivots.begin() + pos, piv);
+    }
+
+    void set_top() {
+        point.assign(vars.size(), Rational(0));
+        basis.clear();
+        pivots.clear();
+        for (size_t col = 0; col < vars.size(); ++col) {
+            Row unit(vars.size(), Rational(0));
+            unit[col] = Rational(1);
+            basis.push_back(unit);
+            pivots.push_back(col);
+        }
+    }
+
+    // Copy of `other` whose columns follow the variable order of this domain,
+    // the variables of `other` must all be known here.
+    AffineEqualityDomain aligned(const AffineEqualityDomain& other) const {
+        AffineEqualityDomain result = other;
+        for (const auto& var : vars) result.column(var);
+        if (result.vars == vars) return result;
+        std::vector<size_t> to(vars.size());
+        for (size_t i = 0; i < vars.size(); ++i) to[i] = index.at(result.vars[i]);
+        auto permute = [&](const Row& row) {
+            Row out(row.size(), Rational(0));
+            for (size_t i = 0; i < row.size(); ++i) out[to[i]] = row[i];
+            return out;
+        };
+        AffineEqualityDomain permuted;
+        permuted.vars = vars;
+        permuted.index = index;
+        permuted.point.assign(vars.size(), Rational(0));
+        for (const auto& row : result.basis) permuted.insert_direction(permute(row));
+        permuted.translate(permute(result.point));
+        return permuted;
+    }
+
+    // Moves the affine space by `offset`, keeping the point reduced.
+    void translate(const Row& offset) {
+        for (size_t i = 0; i < point.size(); ++i) point[i] = point[i] + offset[i];
+        for (size_t r = 0; r < basis.size(); ++r) {
+            Rational f = point[pivots[r]];
+            if (f.is_zero()) continue;
+            for (size_t i = 0; i < point.size(); ++i) point[i] = point[i] - f * basis[r][i];
+        }
+    }
+
+public:
+    AffineEqualityDomain() = default;
+
+    void add(const std::string& var) {
+        column(var);
+    }
+
+    // var = ?
+    void forget(const std::string& var) {
+        try {
+            size_t col = column(var);
+            Row unit(vars.size(), Rational(0));
+            unit[col] = Rational(1);
+            insert_direction(unit);
+        } catch (const std::exception&) {
+            set_top();
+        }
+    }
+
+    // Projects var out of the space and drops its column.
+    void remove(const std::string& var) {
+        auto it = index.find(var);
+        if (it == index.end()) return;
+        size_t col = it->second;
+        AffineEqualityDomain result;
+        for (const auto& v : vars) {
+            if (v == var) continue;
+            result.index[v] = result.vars.size();
+            result.vars.push_back(v);
+        }
+        result.point.assign(result.vars.size(), Rational(0));
+        auto project = [col](const Row& row) {
+            Row out;
+            for (size_t i = 0; i < row.size(); ++i) if (i != col) out.push_back(row[i]);
+            return out;
+        };
+        try {
+            for (const auto& row : basis) result.insert_direction(project(row));
+            result.translate(project(point));
+        } catch (const std::exception&) {
+            result.set_top();
+        }
+        *this = result;
+    }
+
+    // var = expr, applied as an affine map to the point and the directions.
+    void assign(const std::string& var, const AffineExpr& expr) {
+        try {
+            for (const auto& [v, c] : expr.coeffs) column(v);
+            size_t col = column(var);
+            auto image = [&](const Row& row, Rational constant) {
+                Rational value = constant;
+                for (const auto& [v, c] : expr.coeffs) value = value + c * row[index.at(v)];
+                return value;
+            };
+            Row new_point = point;
+            new_point[col] = image(point, expr.constant);
+            std::vector<Row> directions = basis;
+            for (auto& dir : directions) dir[col] = image(dir, Rational(0));
+            point.assign(vars.size(), Rational(0));
+            basis.clear();
+            pivots.clear();
+            for (auto& dir : directions) insert_direction(dir);
+            translate(new_point);
+        } catch (const std::exception&) {
+            set_top();
+        }
+    }
+
+    AffineEqualityDomain join(const AffineEqualityDomain& other) const {
+        AffineEqualityDomain result = *this;
+        try {
+            for (const auto& var : other.vars) result.column(var);
+            AffineEqualityDomain rhs = result.aligned(other);
+            for (const auto& row : rhs.basis) result.insert_direction(row);
+            Row diff(result.vars.size(), Rational(0));
+            for (size_t i = 0; i < diff.size(); ++i) diff[i] = rhs.point[i] - result.point[i];
+            result.insert_direction(diff);
+        } catch (const std::exception&) {
+            result.set_top();
+        }
+        return result;
+    }
+
+    // The equalities sum(coeffs[v] * v) = constant satisfied by the space, one
+    // per non-pivot column: x_j = point_j + sum_r basis[r][j] * x_pivot(r).
+    std::vector<AffineExpr> constraints() const {
+        std::vector<AffineExpr> result;
+        std::vector<bool> is_pivot(vars.size(), false);
+        for (size_t p : pivots) is_pivot[p] = true;
+        for (size_t j = 0; j < vars.size(); ++j) {
+            if (is_pivot[j]) continue;
+            AffineExpr eq;
+            eq.coeffs[vars[j]] = Rational(1);
+            for (size_t r = 0; r < basis.size(); ++r) {
+                if (!basis[r][j].is_zero()) eq.coeffs[vars[pivots[r]]] = -basis[r][j];
+            }
+            eq.constant = point[j];
+            result.push_back(eq);
+        }
+        return result;
+    }
+
+    void print() const {
+        for (const auto& eq : constraints()) {
+            bool first = true;
+            for (const auto& [v, c] : eq.coeffs) {
+                if (!first) report_out() << " + ";
+                report_out() << c << "*" << v;
+                first = false;
+            }
+            report_out() << " = " << eq.constant << std::endl;
+        }
+    }
+
+    bool operator==(const AffineEqualityDomain& other) const {
+        if (vars == other.vars) return point == other.point && basis == other.basis;
+        AffineEqualityDomain lhs = *this;
+        for (const auto& var : other.vars) lhs.column(var);
+        AffineEqualityDomain rhs = lhs.aligned(other);
+        return lhs.point == rhs.point && lhs.basis == rhs.basis;
+    }
+
+    bool operator!=(const AffineEqualityDomain& other) const {
+        return !(*this == other);
+    }
+};
+
+#endif
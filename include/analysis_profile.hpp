@@ -0,0 +1,136 @@
+#ifndef ANALYSIS_PROFILE_HPP
+#define ANALYSIS_PROFILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Widening settings of one loop head.
+struct LoopSettings {
+    uint32_t widening_delay = 0;        // iterations joined without widening
+    // Per variable, widening stops at these bounds before +/-oo.
+    std::map<std::string, std::vector<int64_t>> thresholds;
+};
+
+// What the previous runs learned about a loop head: the best run (the
+// tightest bounds, then the fewest iterations), and the delay to try next.
+struct LoopProfile {
+    uint32_t iterations = 0;            // updates of the loop head before the fixpoint
+    uint32_t widening_delay = 0;
+    uint32_t trial = 0;                 // delay of the next run, past max_trial once the search is over
+    std::map<std::string, std::pair<int64_t, int64_t>> bounds;  // final interval of every variable
+};
+
+// Per-loop profile persisted next to the analyzed source (`prog.c.profile`).
+// Loops are identified by the structural hash of their AST and their rank
+// among the loops of the same structure, so identical loops have their own
+// entries and editing the rest of the program keeps them valid.
+class AnalysisProfile {
+private:
+    std::map<uint64_t, LoopProfile> loops;
+    std::map<uint64_t, uint32_t> occurrences;   // loops of every structure met during this run
+
+    // The delays worth trying: past the iterations the loop needed, the
+    // widening never fires.
+    static constexpr uint32_t max_delay = 8;
+    static uint32_t max_trial(const LoopProfile& loop) {
+        return std::min(loop.iterations, max_delay);
+    }
+
+    // Every variable of `run` is in its interval of `best`, or is not in `best`.
+    static bool within(const LoopProfile& run, const LoopProfile& best) {
+        for (const auto& [var, bound] : run.bounds) {
+            auto it = best.bounds.find(var);
+            if (it != best.bounds.end() && (bound.first < it->second.first || bound.second > it->second.second)) return false;
+        }
+        return true;
+    }
+
+public:
+    static std::string path_for(const std::string& source) {
+        return source + ".profile";
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in.is_open()) return false;
+        std::string line;
+        // loop <key> <iterations> <widening delay> <trial> (<var> <lower> <upper>)*
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string tag, var;
+            uint64_t key;
+            LoopProfile loop;
+            if (!(fields >> tag >> std::hex >> key >> std::dec >> loop.iterations >> loop.widening_delay >> loop.trial) || tag != "loop")
+                continue;
+            int64_t lower, upper;
+            while (fields >> var >> lower >> upper) loop.bounds[var] = {lower, upper};
+            loops[key] = loop;
+        }
+        return true;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        for (const auto& [key, loop] : loops) {
+            out << "loop " << std::hex << key << std::dec << " " << loop.iterations << " " << loop.widening_delay << " " << loop.trial;
+            for (const auto& [var, bound] : loop.bounds) out << " " << var << " " << bound.first << " " << bound.second;
+            out << "\n";
+        }
+        return true;
+    }
+
+    // Key of the next loop of the program whose AST hashes to `hash`: the
+    // first one keeps the hash, the next identical ones are numbered.
+    uint64_t key_for(uint64_t hash) {
+        uint32_t rank = occurrences[hash]++;
+        return rank == 0 ? hash : hash ^ (0x9e3779b97f4a7c15ULL * rank);
+    }
+
+    // The recorded bounds of the loop head are used as widening thresholds:
+    // the variables jump to the previous fixpoint instead of growing one
+    // iteration at a time, or going to +/-oo and then being refined. The
+    // delay is the next one to try, then the fastest one found.
+    LoopSettings settings_for(uint64_t key) const {
+        LoopSettings settings;
+        auto it = loops.find(key);
+        if (it == loops.end()) return settings;
+        settings.widening_delay = it->second.trial <= max_trial(it->second) ? it->second.trial : it->second.widening_delay;
+        for (const auto& [var, bound] : it->second.bounds) {
+            auto& thresholds = settings.thresholds[var];
+            if (bound.first != std::numeric_limits<int64_t>::lowest()) thresholds.push_back(bound.first);
+            if (bound.second != std::numeric_limits<int64_t>::max()) thresholds.push_back(bound.second);
+        }
+        return settings;
+    }
+
+    // `run` used the settings of settings_for. It replaces the best run when
+    // its bounds are tighter, or the same in fewer iterations; a run with
+    // wider bounds never does. The search then moves to the next delay: the
+    // runs after the first one try the delays 0 to max_trial with the
+    // thresholds, one per run.
+    void record(uint64_t key, const LoopProfile& run) {
+        auto it = loops.find(key);
+        if (it == loops.end()) {
+            loops[key] = run;
+            loops[key].trial = 0;
+            return;
+        }
+        LoopProfile& best = it->second;
+        uint32_t trial = best.trial;
+        if (within(run, best) && (run.bounds != best.bounds || run.iterations < best.iterations)) best = run;
+        best.trial = trial <= max_trial(best) ? trial + 1 : trial;
+    }
+
+    const std::map<uint64_t, LoopProfile>& get_loops() const {
+        return loops;
+    }
+};
+
+#endif
@@ -0,0 +1,367 @@
+#ifndef ANALYZER_SOURCE_HPP
+#define ANALYZER_SOURCE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "abstract_interpeter.hpp"
+
+// C++ source of an analyzer specialized to one program, built and loaded by
+// specialized_analyzer.hpp. The transfer function of every location is
+// emitted (LocationEmitter) as a function of the generated file, on stores of
+// the variables of the entry store (SpecializedStore), whose indices are
+// constants, and the expressions are unrolled into calls of
+// interval_transfer.hpp; the analyzer sweeps over them in location order
+// until none changes, as eval_all does. The entry intervals and the bounds of
+// the preconditions are its parameters, so the same analyzer serves the
+// program under other preconditions.
+class AnalyzerSource {
+private:
+    // An interval of a linear form (see linearize), known when generating
+    // the analyzer or computed by `code` when it runs.
+    struct Coefficient {
+        std::optional<Interval<int64_t>> value;
+        std::string code;
+    };
+    struct Form {
+        std::map<std::string, Coefficient> coeffs;
+        Coefficient constant{Interval<int64_t>(0, 0), ""};
+    };
+
+    std::vector<std::string> variables;
+    std::string reason;
+    std::vector<int64_t> values;        // the parameters, lower and upper in a row
+    std::string definitions, functions, initialization, sweep;
+    std::map<std::vector<int64_t>, std::string> tables_by_entries;
+    size_t locations = 0, counters = 0, tables = 0, loops = 0;
+
+    static std::string literal(int64_t value) {
+        if (value == std::numeric_limits<int64_t>::lowest()) return "std::numeric_limits<int64_t>::lowest()";
+        return std::to_string(value);
+    }
+
+    static std::string interval(const Interval<int64_t> &iv) {
+        return "Interval<int64_t>(" + literal(iv.getLower()) + ", " + literal(iv.getUpper()) + ")";
+    }
+
+    static std::string text(const Coefficient &c) { return c.value ? interval(*c.value) : c.code; }
+
+    static bool is_zero(const Coefficient &c) { return c.value && c.value->getLower() == 0 && c.value->getUpper() == 0; }
+
+    static bool is_known(const Form &form) {
+        return form.constant.value && std::all_of(form.coeffs.begin(), form.coeffs.end(), [](const auto &c) { return c.second.value.has_value(); });
+    }
+
+    static Coefficient sum(const Coefficient &a, const Coefficient &b) {
+        if (a.value && b.value) return {saturating_sum(*a.value, *b.value), ""};
+        return {std::nullopt, "saturating_sum(" + text(a) + ", " + text(b) + ")"};
+    }
+
+    static Coefficient product(const Coefficient &a, const Coefficient &b) {
+        if (a.value && b.value) return {saturating_product(*a.value, *b.value), ""};
+        return {std::nullopt, "saturating_product(" + text(a) + ", " + text(b) + ")"};
+    }
+
+    // QuasiLinearForm::operator+ and scale. A coefficient computed by the
+    // analyzer is not dropped when it is 0, which evaluates the same.
+    static Form plus(const Form &a, const Form &b) {
+        Form result = a;
+        for (const auto &[var, coef] : b.coeffs) {
+            auto it = result.coeffs.find(var);
+            if (it == result.coeffs.end()) result.coeffs.emplace(var, coef);
+            else if (is_zero(it->second = sum(it->second, coef))) result.coeffs.erase(it);
+        }
+        result.constant = sum(a.constant, b.constant);
+        return result;
+    }
+
+    static Form scale(const Form &form, const Coefficient &factor) {
+        Form result;
+        if (is_zero(factor)) return result;
+        for (const auto &[var, coef] : form.coeffs) result.coeffs.emplace(var, product(coef, factor));
+        result.constant = product(form.constant, factor);
+        return result;
+    }
+
+    std::string evaluate(const Form &form, const std::string &store) {
+        std::string result = text(form.constant);
+        for (const auto &[var, coef] : form.coeffs)
+            result = "saturating_sum(" + result + ", saturating_product(" + text(coef) + ", " + store + ".intervals[" + std::to_string(*index_of(var)) + "]))";
+        return result;
+    }
+
+    static Form top() {
+        Form form;
+        form.constant.value = Interval<int64_t>();
+        return form;
+    }
+
+    // linearize, the decisions it takes on the store being taken when the
+    // analyzer is generated: the operands of a product must have known
+    // coefficients, and a divisor must be a constant.
+    std::optional<Form> linear(const ASTNode &node, const std::string &store) {
+        if (node.type == NodeType::INTEGER) {
+            Form form;
+            int64_t value = std::get<int>(node.value);
+            form.constant.value = Interval<int64_t>(value, value);
+            return form;
+        }
+        if (node.type == NodeType::VARIABLE) {
+            const std::string &var = std::get<std::string>(node.value);
+            if (!index_of(var)) return std::nullopt;
+            Form form;
+            form.coeffs.emplace(var, Coefficient{Interval<int64_t>(1, 1), ""});
+            return form;
+        }
+        if (node.type == NodeType::ARRAY_ACCESS) {
+            fail("arrays");
+            return std::nullopt;
+        }
+        if (node.type != NodeType::ARITHM_OP || node.children.size() != 2) return top();
+
+        const ASTNode &lhs = node.children[0], &rhs = node.children[1];
+        BinOp op = get_binop(node);
+        if (op != BinOp::ADD && op != BinOp::SUB && op != BinOp::MUL && op != BinOp::DIV) return top();
+        if (op == BinOp::DIV) {
+            auto right = linear(rhs, store);
+            if (!right) return std::nullopt;
+            if (!right->coeffs.empty() || !right->constant.value) {
+                fail("a division by a variable");
+                return std::nullopt;
+            }
+            Interval<int64_t> divisor = *right->constant.value;
+            if (!divisor.contains(0) && lhs.type == NodeType::ARITHM_OP && lhs.children.size() == 2 && get_binop(lhs) == BinOp::MUL) {
+                if (same_expr(lhs.children[1], rhs)) return linear(lhs.children[0], store);
+                if (same_expr(lhs.children[0], rhs)) return linear(lhs.children[1], store);
+            }
+            auto left = linear(lhs, store);
+            if (!left) return std::nullopt;
+            int64_t k = divisor.getLower();
+            if (divisor.getLower() == divisor.getUpper() && k != 0) {
+                // QuasiLinearForm::divide_exact
+                if (!is_known(*left)) {
+                    fail("a division of a non-linear expression");
+                    return std::nullopt;
+                }
+                auto divisible = [k](const Interval<int64_t> &iv) {
+                    return iv.getLower() == iv.getUpper() && iv.getLower() != std::numeric_limits<int64_t>::lowest()
+                        && iv.getLower() != std::numeric_limits<int64_t>::max() && iv.getLower() % k == 0;
+                };
+                bool exact = divisible(*left->constant.value);
+                for (const auto &[var, coef] : left->coeffs) exact = exact && divisible(*coef.value);
+                if (exact) {
+                    Form quotient;
+                    quotient.constant.value = Interval<int64_t>(left->constant.value->getLower() / k, left->constant.value->getLower() / k);
+                    for (const auto &[var, coef] : left->coeffs)
+                        quotient.coeffs.emplace(var, Coefficient{Interval<int64_t>(coef.value->getLower() / k, coef.value->getLower() / k), ""});
+                    return quotient;
+                }
+            }
+            if (divisor.contains(0)) return top();
+            Form quotient;
+            quotient.constant = Coefficient{std::nullopt, "(" + evaluate(*left, store) + ") / " + interval(divisor)};
+            return quotient;
+        }
+
+        auto left = linear(lhs, store), right = linear(rhs, store);
+        if (!left || !right) return std::nullopt;
+        if (op == BinOp::ADD) return plus(*left, *right);
+        if (op == BinOp::SUB) return plus(*left, scale(*right, Coefficient{Interval<int64_t>(-1, -1), ""}));
+        // Whether a form is constant must not depend on the store.
+        auto known_coeffs = [](const Form &form) {
+            return std::all_of(form.coeffs.begin(), form.coeffs.end(), [](const auto &c) { return c.second.value.has_value(); });
+        };
+        if (!known_coeffs(*left) || !known_coeffs(*right)) {
+            fail("a product of non-linear expressions");
+            return std::nullopt;
+        }
+        if (right->coeffs.empty()) return scale(*left, right->constant);
+        if (left->coeffs.empty()) return scale(*right, left->constant);
+        return scale(*right, Coefficient{std::nullopt, evaluate(*left, store)});
+    }
+
+    // evalIntervalExpr.
+    std::optional<std::string> direct(const ASTNode &node, const std::string &store) {
+        if (node.type == NodeType::INTEGER) {
+            int64_t value = std::get<int>(node.value);
+            return interval(Interval<int64_t>(value, value));
+        }
+        if (node.type == NodeType::VARIABLE) {
+            auto k = index_of(std::get<std::string>(node.value));
+            if (!k) return std::nullopt;
+            return store + ".intervals[" + std::to_string(*k) + "]";
+        }
+        if (node.type == NodeType::ARRAY_ACCESS) {
+            fail("arrays");
+            return std::nullopt;
+        }
+        if (node.type != NodeType::ARITHM_OP || node.children.size() != 2) {
+            fail("an unsupported expression");
+            return std::nullopt;
+        }
+        static const std::map<BinOp, std::string> names = {
+            {BinOp::ADD, "BinOp::ADD"}, {BinOp::SUB, "BinOp::SUB"}, {BinOp::MUL, "BinOp::MUL"}, {BinOp::DIV, "BinOp::DIV"}, {BinOp::MOD, "BinOp::MOD"}};
+        auto name = names.find(get_binop(node));
+        if (name == names.end()) {
+            fail("bitwise operations");
+            return std::nullopt;
+        }
+        auto left = direct(node.children[0], store), right = direct(node.children[1], store);
+        if (!left || !right) return std::nullopt;
+        return "interval_arithmetic(" + name->second + ", " + *left + ", " + *right + ")";
+    }
+
+public:
+    // `variables` are the ones of the entry store, by name: the index of a
+    // variable in the generated stores is its rank.
+    explicit AnalyzerSource(const std::vector<std::string> &variables) : variables(variables) {}
+
+    // Records why the program cannot be specialized, returns false.
+    bool fail(const std::string &why) {
+        if (reason.empty()) reason = why;
+        return false;
+    }
+
+    const std::string &failure() const { return reason; }
+
+    // The index of var in the stores, nullopt (failing) when the entry store
+    // does not hold it.
+    std::optional<size_t> index_of(const std::string &var) {
+        auto it = std::lower_bound(variables.begin(), variables.end(), var);
+        if (it != variables.end() && *it == var) return static_cast<size_t>(it - variables.begin());
+        fail("the undeclared variable `" + var + "`");
+        return std::nullopt;
+    }
+
+    // The code of evalArithmeticExpr(node, store) and evalLogicalExpr(node,
+    // store), nullopt (failing) when the analyzer cannot evaluate it.
+    std::optional<std::string> arithmetic(const ASTNode &node, const std::string &store) {
+        auto value = direct(node, store);
+        if (!value || node.type != NodeType::ARITHM_OP) return value;
+        auto form = linear(node, store);
+        if (!form) return std::nullopt;
+        return "(" + *value + ").meet(" + evaluate(*form, store) + ")";
+    }
+
+    std::optional<std::string> logical(const ASTNode &node, const std::string &store) {
+        static const std::map<LogicOp, std::string> names = {
+            {LogicOp::LE, "LogicOp::LE"}, {LogicOp::LEQ, "LogicOp::LEQ"}, {LogicOp::GE, "LogicOp::GE"},
+            {LogicOp::GEQ, "LogicOp::GEQ"}, {LogicOp::EQ, "LogicOp::EQ"}, {LogicOp::NEQ, "LogicOp::NEQ"}};
+        if (node.type != NodeType::LOGIC_OP || node.children.size() != 2) {
+            fail("an unsupported guard");
+            return std::nullopt;
+        }
+        auto left = arithmetic(node.children[0], store), right = arithmetic(node.children[1], store);
+        if (!left || !right) return std::nullopt;
+        return "interval_comparison(" + names.at(std::get<LogicOp>(node.value)) + ", " + *left + ", " + *right + ")";
+    }
+
+    // The code reading a new parameter, whose value for this run is `value`.
+    std::string parameter(const Interval<int64_t> &value) {
+        values.push_back(value.getLower());
+        values.push_back(value.getUpper());
+        return "s.parameter(" + std::to_string(values.size() / 2 - 1) + ")";
+    }
+
+    // The name of a constant table of the analyzer, the same for the same
+    // entries.
+    std::string table(const std::vector<int64_t> &entries) {
+        auto known = tables_by_entries.find(entries);
+        if (known != tables_by_entries.end()) return known->second;
+        std::string name = "table" + std::to_string(tables++);
+        tables_by_entries.emplace(entries, name);
+        definitions += "const std::vector<int64_t> " + name + " = {";
+        for (size_t k = 0; k < entries.size(); ++k) definitions += (k ? ", " : "") + literal(entries[k]);
+        definitions += "};\n";
+        return name;
+    }
+
+    std::string counted_loop(const CountedLoop &loop) {
+        std::string name = "loop" + std::to_string(loops++);
+        definitions += "const CountedLoop " + name + "(\"" + loop.get_counter() + "\", " + literal(loop.get_limit()) + ", {";
+        bool first = true;
+        for (const auto &[var, step] : loop.get_steps()) {
+            definitions += std::string(first ? "" : ", ") + "{\"" + var + "\", " + literal(step) + "}";
+            first = false;
+        }
+        definitions += "});\n";
+        return name;
+    }
+
+    // A counter of the analyzer, 0 when it starts.
+    std::string counter() { return "s.counters[" + std::to_string(counters++) + "]"; }
+
+    // Location `index` holds the entry store, given as parameters.
+    void entry(size_t index, const Store &store) {
+        locations = std::max(locations, index + 1);
+        std::string at = "s.stores[" + std::to_string(index) + "]";
+        initialization += "    " + at + ".unreachable = false;\n";
+        for (const auto &var : store.get_variables())
+            initialization += "    " + at + ".intervals[" + std::to_string(*index_of(var)) + "] = " + parameter(store.get_interval(var)) + ";\n";
+    }
+
+    // The transfer function of location `index`, statements returning its
+    // new store from `in0`, `in1`... (the stores of `inputs`) and `self`
+    // (its previous store). As location::output, nothing reaches it when
+    // all its inputs are unreachable.
+    void location(size_t index, const std::vector<size_t> &inputs, const std::string &transfer) {
+        locations = std::max(locations, index + 1);
+        std::string i = std::to_string(index);
+        functions += "bool location_" + i + "(State &s) {\n";
+        std::string unreachable;
+        for (size_t p = 0; p < inputs.size(); ++p) {
+            functions += "    const Store &in" + std::to_string(p) + " = s.stores[" + std::to_string(inputs[p]) + "];\n";
+            unreachable += (p ? " && in" : "in") + std::to_string(p) + ".unreachable";
+        }
+        functions += "    const Store &self = s.stores[" + i + "];\n    (void)self;\n";
+        if (!inputs.empty()) functions += "    if (" + unreachable + ") return s.update(" + i + ", Store::bottom());\n";
+        functions += "    return s.update(" + i + ", [&]() -> Store {\n";
+        for (size_t start = 0, end; start < transfer.size(); start = end + 1) {
+            end = transfer.find('\n', start);
+            if (end == std::string::npos) end = transfer.size();
+            functions += "        " + transfer.substr(start, end - start) + "\n";
+        }
+        functions += "    }());\n}\n\n";
+        sweep += "        end = location_" + i + "(s) && end;\n";
+    }
+
+    // The parameters of this run, lower and upper bounds in a row.
+    const std::vector<int64_t> &parameters() const { return values; }
+
+    size_t location_count() const { return locations; }
+    size_t variable_count() const { return variables.size(); }
+    const std::vector<std::string> &get_variables() const { return variables; }
+
+    // The whole source: absint_specialized_shape gives the number of
+    // locations, variables and parameters, absint_specialized_run solves
+    // the program from its parameters and writes the stores of the fixpoint
+    // (SpecializedState::write), returning the number of sweeps.
+    std::string text() const {
+        std::string n = std::to_string(variables.size());
+        std::string source = "// Analyzer of one program generated by absint (specialized_analyzer.hpp, version "
+                             + std::to_string(version) + "): " + n + " variables, " + std::to_string(locations) + " locations.\n";
+        source += "#include \"specialized_store.hpp\"\n\nnamespace {\nstruct Names {\n    static constexpr const char* value[] = {";
+        for (const auto &var : variables) source += "\"" + var + "\", ";
+        source += "nullptr};\n};\nusing Store = SpecializedStore<" + n + ", Names>;\n";
+        source += "using State = SpecializedState<Store, " + std::to_string(counters) + ">;\n\n";
+        source += definitions + "\n" + functions + "}\n\n";
+        source += "extern \"C\" {\nextern const uint64_t absint_specialized_shape[3] = {" + std::to_string(locations) + ", " + n + ", "
+                + std::to_string(values.size() / 2) + "};\n\n";
+        source += "uint64_t absint_specialized_run(const int64_t *parameters, uint8_t *unreachable, int64_t *bounds, uint32_t *classes) {\n";
+        source += "    State s(parameters, " + std::to_string(locations) + ");\n" + initialization;
+        source += "    uint64_t iterations = 0;\n    for (bool end = false; !end; ++iterations) {\n        end = true;\n" + sweep + "    }\n";
+        source += "    s.write(unreachable, bounds, classes);\n    return iterations;\n}\n}\n";
+        return source;
+    }
+
+    // Changes with the interface of the generated analyzers, so that the
+    // ones built by an older absint are not reused.
+    static constexpr int version = 1;
+};
+
+#endif
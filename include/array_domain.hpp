@@ -0,0 +1,164 @@
+#ifndef ARRAY_DOMAIN_HPP
+#define ARRAY_DOMAIN_HPP
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "interval.hpp"
+#include "report.hpp"
+
+// Elements of an `int a[N]`, as at most `max_segments` segments of constant
+// bounds, each holding one interval for all its elements. One segment is the
+// smashed abstraction; with more, the writes to a constant index are strong
+// updates that split the segments, and the segments beyond the bound are
+// merged back. Either way the size of the abstraction does not depend on N.
+class ArrayValue {
+private:
+    int64_t size;
+    size_t max_segments;
+    // Segment k covers [bounds[k], bounds[k + 1]) with values[k];
+    // bounds.front() = 0 and bounds.back() = size.
+    std::vector<int64_t> bounds;
+    std::vector<Interval<int64_t>> values;
+
+    static long double width(const Interval<int64_t>& iv) {
+        return static_cast<long double>(iv.getUpper()) - static_cast<long double>(iv.getLower());
+    }
+
+    // Join of the segments overlapping [lower, upper], in bounds.
+    Interval<int64_t> join_range(int64_t lower, int64_t upper) const {
+        Interval<int64_t> result = Interval<int64_t>::build_empty();
+        for (size_t k = 0; k < values.size(); ++k)
+            if (bounds[k] <= upper && bounds[k + 1] > lower) result = result.join(values[k]);
+        return result;
+    }
+
+    // Adjacent equal segments are merged, then the pairs whose join is the
+    // narrowest until at most max_segments remain.
+    void normalize() {
+        for (size_t k = 1; k < values.size();) {
+            if (values[k - 1] == values[k]) {
+                bounds.erase(bounds.begin() + k);
+                values.erase(values.begin() + k);
+            }
+            else ++k;
+        }
+        while (values.size() > max_segments) {
+            size_t best = 1;
+            for (size_t k = 2; k < values.size(); ++k)
+                if (width(values[k - 1].join(values[k])) < width(values[best - 1].join(values[best]))) best = k;
+            values[best - 1] = values[best - 1].join(values[best]);
+            bounds.erase(bounds.begin() + best);
+            values.erase(values.begin() + best);
+        }
+    }
+
+    // Makes `at` the bound of a segment.
+    void split(int64_t at) {
+        for (size_t k = 0; k < values.size(); ++k) {
+            if (bounds[k] == at) return;
+            if (bounds[k] < at && at < bounds[k + 1]) {
+                bounds.insert(bounds.begin() + k + 1, at);
+                values.insert(values.begin() + k + 1, values[k]);
+                return;
+            }
+        }
+    }
+
+    // Same segments as `other`'s and this one's bounds together, the value of
+    // each being `combine` of both values on it.
+    template <typename Combine>
+    ArrayValue merge(const ArrayValue& other, Combine combine) const {
+        if (size != other.size) throw std::runtime_error("Arrays of different sizes");
+        ArrayValue result(size, Interval<int64_t>(), max_segments);
+        result.bounds.clear();
+        result.values.clear();
+        size_t i = 0, j = 0;
+        int64_t lower = 0;
+        while (lower < size) {
+            while (bounds[i + 1] <= lower) i++;
+            while (other.bounds[j + 1] <= lower) j++;
+            int64_t upper = std::min(bounds[i + 1], other.bounds[j + 1]);
+            result.bounds.push_back(lower);
+            result.values.push_back(combine(values[i], other.values[j]));
+            lower = upper;
+        }
+        result.bounds.push_back(size);
+        result.normalize();
+        return result;
+    }
+
+public:
+    ArrayValue(int64_t size, const Interval<int64_t>& init, size_t max_segments)
+        : size(size), max_segments(max_segments == 0 ? 1 : max_segments), bounds{0, size}, values{init} {
+        if (size <= 0) throw std::runtime_error("Invalid array size");
+    }
+
+    int64_t get_size() const { return size; }
+
+    // The indices of [lower, upper] within the array, empty when there is none.
+    Interval<int64_t> in_bounds(const Interval<int64_t>& index) const {
+        return index.meet(Interval<int64_t>(0, size - 1));
+    }
+
+    // The elements the index may read, top if it is always out of bounds.
+    Interval<int64_t> read(const Interval<int64_t>& index) const {
+        Interval<int64_t> valid = in_bounds(index);
+        if (valid.isEmpty()) return Interval<int64_t>();
+        return join_range(valid.getLower(), valid.getUpper());
+    }
+
+    // Strong update of a single index when the array has segments to isolate
+    // it (or only one element), weak update of the range otherwise.
+    void write(const Interval<int64_t>& index, const Interval<int64_t>& value) {
+        Interval<int64_t> valid = in_bounds(index);
+        if (valid.isEmpty()) return;
+        int64_t lower = valid.getLower(), upper = valid.getUpper();
+        bool strong = lower == upper && (max_segments > 1 || size == 1);
+        if (strong) {
+            split(lower);
+            split(lower + 1);
+        }
+        for (size_t k = 0; k < values.size(); ++k) {
+            if (bounds[k] > upper || bounds[k + 1] <= lower) continue;
+            if (strong) values[k] = value;
+            else values[k] = values[k].join(value);
+        }
+        normalize();
+    }
+
+    ArrayValue join(const ArrayValue& other) const {
+        return merge(other, [](const Interval<int64_t>& a, const Interval<int64_t>& b) { return a.join(b); });
+    }
+
+    // Elements growing past their values in `old` jump to +/-oo.
+    ArrayValue widen(const ArrayValue& old) const {
+        ArrayValue result = *this;
+        for (size_t k = 0; k < result.values.size(); ++k) {
+            Interval<int64_t> before = old.join_range(bounds[k], bounds[k + 1] - 1);
+            if (!before.isEmpty()) result.values[k] = before.widen(values[k]);
+        }
+        result.normalize();
+        return result;
+    }
+
+    void print(const std::string& name) const {
+        for (size_t k = 0; k < values.size(); ++k) {
+            report_out() << name << "[" << bounds[k] << ".." << bounds[k + 1] - 1 << "] = [" << values[k].getLower()
+                         << ", " << values[k].getUpper() << "]" << std::endl;
+        }
+    }
+
+    bool operator==(const ArrayValue& other) const {
+        return size == other.size && bounds == other.bounds && values == other.values;
+    }
+
+    bool operator!=(const ArrayValue& other) const {
+        return !(*this == other);
+    }
+};
+
+#endif
@@ -3,16 +3,26 @@
 #ifndef ABSTRACT_INTERPRETER_AST_HPP
 #define ABSTRACT_INTERPRETER_AST_HPP
 
+#include <set>
+#include <string>
 #include <variant>
 #include <cmath>
+#include <cstdint>
+#include "report.hpp"
 
-enum class BinOp {ADD, SUB, MUL, DIV};
+enum class BinOp {ADD, SUB, MUL, DIV, MOD, AND, OR, XOR, SHL, SHR};
 std::ostream& operator<<(std::ostream& os, BinOp op) {
     switch (op) {
         case BinOp::ADD: os << "+"; break;
         case BinOp::SUB: os << "-"; break;
         case BinOp::MUL: os << "*"; break;
         case BinOp::DIV: os << "/"; break;
+        case BinOp::MOD: os << "%"; break;
+        case BinOp::AND: os << "&"; break;
+        case BinOp::OR: os << "|"; break;
+        case BinOp::XOR: os << "^"; break;
+        case BinOp::SHL: os << "<<"; break;
+        case BinOp::SHR: os << ">>"; break;
     }
     return os;
 }
@@ -30,7 +40,7 @@ std::ostream& operator<<(std::ostream& os, LogicOp lop){
     return os;
 }
 
-enum class NodeType {VARIABLE, INTEGER, PRE_CON, POST_CON, ARITHM_OP, LOGIC_OP, DECLARATION, ASSIGNMENT, IFELSE, WHILELOOP, SEQUENCE};
+enum class NodeType {VARIABLE, INTEGER, PRE_CON, POST_CON, ARITHM_OP, LOGIC_OP, DECLARATION, ASSIGNMENT, IFELSE, WHILELOOP, SEQUENCE, BREAK, CONTINUE, ARRAY_DECL, ARRAY_ACCESS, BOOL_OP};
 std::ostream& operator<<(std::ostream& os, NodeType type) {
     switch (type) {
         case NodeType::VARIABLE: os << "Variable"; break;
@@ -44,6 +54,11 @@ std::ostream& operator<<(std::ostream& os, NodeType type) {
         case NodeType::IFELSE: os << "If-Else"; break;
         case NodeType::WHILELOOP: os << "While-Loop"; break;
         case NodeType::SEQUENCE: os << "Sequence"; break;
+        case NodeType::BREAK: os << "Break"; break;
+        case NodeType::CONTINUE: os << "Continue"; break;
+        case NodeType::ARRAY_DECL: os << "Array Declaration"; break;
+        case NodeType::ARRAY_ACCESS: os << "Array Access"; break;
+        case NodeType::BOOL_OP: os << "Boolean Operation"; break;
     }
     return os;
 }
@@ -55,6 +70,9 @@ struct ASTNode {
     NodeType type;
     VType value;
     ASTNodes children;
+    // Byte offset of a statement in the parsed source, npos for the other
+    // nodes. Not part of the hash.
+    size_t offset = std::string::npos;
 
     ASTNode(): type(NodeType::INTEGER), value(0) {}
     ASTNode(const std::string& name): type(NodeType::VARIABLE), value(name){}
@@ -75,19 +93,35 @@ struct ASTNode {
 
     static void printVariant(const std::variant<std::string, int, BinOp, LogicOp>& value) {
         std::visit([](const auto& v) {
-            std::cout << v << std::endl;
+            report_out() << v << std::endl;
         }, value);
     }
 
     static void printVariantType(const std::variant<std::string, int, BinOp, LogicOp>& value) {
         std::visit([](const auto& v) {
-            std::cout << typeid(v).name() << std::endl;
+            report_out() << typeid(v).name() << std::endl;
         }, value);
     }
 
+    // Structural hash (FNV-1a) of the subtree, stable from one run to the next.
+    uint64_t hash() const {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](uint64_t v) {
+            for (int i = 0; i < 8; ++i) { h ^= (v >> (8 * i)) & 0xff; h *= 1099511628211ull; }
+        };
+        mix(static_cast<uint64_t>(type));
+        mix(value.index());
+        if (auto s = std::get_if<std::string>(&value)) for (char c : *s) mix(static_cast<unsigned char>(c));
+        else if (auto i = std::get_if<int>(&value)) mix(static_cast<uint64_t>(*i));
+        else if (auto b = std::get_if<BinOp>(&value)) mix(static_cast<uint64_t>(*b));
+        else if (auto l = std::get_if<LogicOp>(&value)) mix(static_cast<uint64_t>(*l));
+        for (const auto& child : children) mix(child.hash());
+        return h;
+    }
+
     void print(int depth = 0) const {
         std::string indent(depth * 2, ' ');
-        std::cout << indent << "NodeType: " << type << ", Value: ";
+        report_out() << indent << "NodeType: " << type << ", Value: ";
         printVariant(value);
         for (const auto& child : children) {
             child.print(depth + 1);
@@ -95,4 +129,23 @@ struct ASTNode {
     }
 };
 
+// Every variable the subtree mentions, arrays included.
+void collect_variables(const ASTNode& node, std::set<std::string>& vars) {
+    if (node.type == NodeType::VARIABLE || node.type == NodeType::ARRAY_ACCESS) vars.insert(std::get<std::string>(node.value));
+    for (const auto& child : node.children) collect_variables(child, vars);
+}
+
+// For a subtree parsed from the part of a source starting at `base`.
+void shift_offsets(ASTNode& node, size_t base) {
+    if (node.offset != std::string::npos) node.offset += base;
+    for (auto& child : node.children) shift_offsets(child, base);
+}
+
+bool has_array_access(const ASTNode& node) {
+    if (node.type == NodeType::ARRAY_ACCESS) return true;
+    for (const auto& child : node.children)
+        if (has_array_access(child)) return true;
+    return false;
+}
+
 #endif
@@ -0,0 +1,163 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "report.hpp"
+
+// Queue between two stages of the pipeline. push() blocks while the queue is
+// full, which holds back a stage running ahead of the next one (backpressure).
+// Once every producer is done, pop() drains the queue and then returns nothing.
+template <typename T>
+class BoundedQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    size_t capacity;
+    size_t producers;
+
+public:
+    BoundedQueue(size_t capacity, size_t producers) : capacity(std::max<size_t>(capacity, 1)), producers(producers) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return !items.empty() || producers == 0; });
+        if (items.empty()) return std::nullopt;
+        T item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return item;
+    }
+
+    // Called by every producer when it has nothing left to push.
+    void done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--producers == 0) not_empty.notify_all();
+    }
+};
+
+// Analysis of independent programs as a pipeline of three stages: while the
+// parsers work on the next programs, the solvers work on the programs already
+// parsed and the reports of the finished ones are written. The stages are
+// connected by bounded queues, so at most a few parsed programs wait for a
+// solver whatever the stage that is slower, and at most `window` programs
+// are in flight at any time.
+//
+// Every stage captures the messages of a program, and the reports are written
+// in input order: the output is the same byte for byte for any number of
+// threads and any scheduling. The only shared state, the header cache, does
+// not change what a program preprocesses to.
+class BatchExecutor {
+private:
+    unsigned jobs;
+
+    template <typename Program>
+    struct Parsed {
+        size_t index;
+        std::string report;
+        std::optional<Program> program;
+    };
+
+    struct Solved {
+        size_t index;
+        std::string report;
+    };
+
+public:
+    explicit BatchExecutor(unsigned jobs) : jobs(jobs == 0 ? 1 : jobs) {}
+
+    // `parse(index, worker)` is called once for every index in [0, count) and
+    // returns nothing on error; `solve(program)` is called on every program it
+    // returned. `worker` is in [0, jobs), so that the callers can keep a parser
+    // per thread. Returns the number of programs that could not be parsed.
+    template <typename Program>
+    size_t run(size_t count,
+               const std::function<std::optional<Program>(size_t, unsigned)>& parse,
+               const std::function<void(Program&)>& solve,
+               std::ostream& out) {
+        unsigned threads = static_cast<unsigned>(std::max<size_t>(std::min<size_t>(jobs, count), 1));
+        BoundedQueue<Parsed<Program>> parsed(threads, threads);
+        BoundedQueue<Solved> solved(threads, threads);
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> failures{0};
+        // A program is only started when the report `window` places before it
+        // is written, which also bounds the reports waiting for a slow one.
+        const size_t window = 4 * static_cast<size_t>(threads);
+        size_t written = 0;
+        std::mutex written_mutex;
+        std::condition_variable written_changed;
+
+        auto parser = [&](unsigned worker) {
+            for (size_t index = next++; index < count; index = next++) {
+                {
+                    std::unique_lock<std::mutex> lock(written_mutex);
+                    written_changed.wait(lock, [&] { return index < written + window; });
+                }
+                Parsed<Program> item{index, "", std::nullopt};
+                {
+                    ReportCapture capture;
+                    item.program = parse(index, worker);
+                    item.report = capture.str();
+                }
+                if (!item.program) failures++;
+                parsed.push(std::move(item));
+            }
+            parsed.done();
+        };
+        auto solver = [&]() {
+            while (auto item = parsed.pop()) {
+                Solved result{item->index, std::move(item->report)};
+                if (item->program) {
+                    ReportCapture capture;
+                    solve(*item->program);
+                    result.report += capture.str();
+                }
+                item.reset();
+                solved.push(std::move(result));
+            }
+            solved.done();
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned worker = 0; worker < threads; ++worker) {
+            workers.emplace_back(parser, worker);
+            workers.emplace_back(solver);
+        }
+        // The reports finished out of order wait here for the previous ones.
+        std::map<size_t, std::string> pending;
+        while (auto result = solved.pop()) {
+            pending.emplace(result->index, std::move(result->report));
+            for (auto it = pending.begin(); it != pending.end() && it->first == written; it = pending.erase(it)) {
+                out << it->second;
+                std::lock_guard<std::mutex> lock(written_mutex);
+                written++;
+                written_changed.notify_all();
+            }
+            out.flush();
+        }
+        for (auto& thread : workers) thread.join();
+        return failures;
+    }
+};
+
+#endif
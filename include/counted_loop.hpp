@@ -0,0 +1,199 @@
+#ifndef COUNTED_LOOP_HPP
+#define COUNTED_LOOP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "interval.hpp"
+
+// Closed form of the counted loops, `while (x <= N) { ... x = x + c; ... }` or
+// `x < N`, with a constant c > 0. The counter is assigned once at the top of the
+// body and nowhere else, and the body has no break nor continue, so after k
+// iterations x is x0 + k * c. The loop head and exit intervals of x, and of
+// every variable `y = y + d` assigned the same way, follow from the entry
+// store without iterating.
+class CountedLoop {
+private:
+    using Wide = __int128;
+    static constexpr int64_t neg_inf = std::numeric_limits<int64_t>::lowest();
+    static constexpr int64_t pos_inf = std::numeric_limits<int64_t>::max();
+
+    std::string counter;
+    int64_t limit;                              // the loop runs while counter <= limit
+    std::map<std::string, int64_t> steps;       // induction variable -> increment, counter included
+
+    // Values beyond the int64 range are +/-oo.
+    static int64_t clamp(Wide v) {
+        if (v <= neg_inf) return neg_inf;
+        if (v >= pos_inf) return pos_inf;
+        return static_cast<int64_t>(v);
+    }
+
+    static bool is_constant(const ASTNode &node, int64_t &value) {
+        if (node.type != NodeType::INTEGER) return false;
+        value = std::get<int>(node.value);
+        return true;
+    }
+
+    static bool is_variable(const ASTNode &node, const std::string &var) {
+        return node.type == NodeType::VARIABLE && std::get<std::string>(node.value) == var;
+    }
+
+    // `+` or `-`, held as a BinOp or as a string (`x++`, `-x`).
+    static std::optional<int> sign_of(const ASTNode &node) {
+        if (auto op = std::get_if<BinOp>(&node.value)) {
+            if (*op == BinOp::ADD) return 1;
+            if (*op == BinOp::SUB) return -1;
+        }
+        else if (auto op = std::get_if<std::string>(&node.value)) {
+            if (*op == "+") return 1;
+            if (*op == "-") return -1;
+        }
+        return std::nullopt;
+    }
+
+    // `var = var + d`, `var = d + var` or `var = var - d`.
+    static std::optional<int64_t> increment_of(const ASTNode &assignment) {
+        const std::string &var = std::get<std::string>(assignment.children[0].value);
+        const ASTNode &expr = assignment.children[1];
+        if (expr.type != NodeType::ARITHM_OP || expr.children.size() != 2) return std::nullopt;
+        auto sign = sign_of(expr);
+        int64_t d;
+        if (!sign) return std::nullopt;
+        if (is_variable(expr.children[0], var) && is_constant(expr.children[1], d)) return *sign * d;
+        if (*sign > 0 && is_constant(expr.children[0], d) && is_variable(expr.children[1], var)) return d;
+        return std::nullopt;
+    }
+
+    // Counts the assignments (declarations and preconditions included) of
+    // every variable, returns false on a jump out of this loop.
+    static bool count_writes(const ASTNode &node, std::map<std::string, int> &writes, bool nested) {
+        if (node.type == NodeType::BREAK || node.type == NodeType::CONTINUE) return nested;
+        if (node.type == NodeType::ASSIGNMENT) writes[std::get<std::string>(node.children[0].value)]++;
+        else if (node.type == NodeType::DECLARATION) {
+            for (const auto &child : node.children)
+                if (child.type == NodeType::VARIABLE) writes[std::get<std::string>(child.value)] += 2;
+        }
+        else if (node.type == NodeType::PRE_CON) writes[std::get<std::string>(node.children[0].children[1].value)] += 2;
+        bool inner = nested || node.type == NodeType::WHILELOOP;
+        for (const auto &child : node.children)
+            if (!count_writes(child, writes, inner)) return false;
+        return true;
+    }
+
+    // Number of iterations before the exit, for the entry interval of the counter.
+    std::pair<Wide, Wide> exit_trips(const Interval<int64_t> &entry) const {
+        int64_t step = steps.at(counter);
+        auto trips = [&](Wide x0) { return x0 > limit ? Wide(0) : (Wide(limit) - x0) / step + 1; };
+        Wide most = entry.getLower() == neg_inf ? Wide(pos_inf) : trips(entry.getLower());
+        Wide least = entry.getUpper() == pos_inf ? Wide(0) : trips(entry.getUpper());
+        return {least, most};
+    }
+
+    // Smallest and largest (limit - x0) mod step for x0 in [lower, upper], upper <= limit.
+    std::pair<int64_t, int64_t> residues(Wide lower, Wide upper) const {
+        int64_t step = steps.at(counter);
+        int64_t last = static_cast<int64_t>((Wide(limit) - upper) % step);
+        Wide spread = upper - lower;
+        int64_t least = last == 0 || spread >= step - last ? 0 : last;
+        int64_t most = spread + last >= step ? step - 1 : static_cast<int64_t>(last + spread);
+        return {least, most};
+    }
+
+    // y0 + d * [least, most] for every induction variable but the counter.
+    template <typename S>
+    void shift_inductions(const S &entry, S &store, Wide least, Wide most) const {
+        for (const auto &[var, d] : steps) {
+            if (var == counter) continue;
+            Interval<int64_t> y0 = entry.get_interval(var);
+            Wide low = d >= 0 ? least : most, high = d >= 0 ? most : least;
+            bool low_inf = y0.getLower() == neg_inf || (d < 0 && low >= pos_inf);
+            bool high_inf = y0.getUpper() == pos_inf || (d > 0 && high >= pos_inf);
+            store.set_interval(var, Interval<int64_t>(low_inf ? neg_inf : clamp(Wide(y0.getLower()) + Wide(d) * low),
+                                                      high_inf ? pos_inf : clamp(Wide(y0.getUpper()) + Wide(d) * high)));
+        }
+    }
+
+public:
+    CountedLoop() = default;
+    // The loop of the analyzers generated for a program, see specialized_analyzer.hpp.
+    CountedLoop(const std::string &counter, int64_t limit, const std::map<std::string, int64_t> &steps)
+        : counter(counter), limit(limit), steps(steps) {}
+
+    // `guard` is the condition of the loop, `body` its body.
+    static std::optional<CountedLoop> recognize(const ASTNode &guard, const ASTNode &body) {
+        if (guard.type != NodeType::LOGIC_OP || guard.children.size() != 2 || guard.children[0].type != NodeType::VARIABLE) return std::nullopt;
+        LogicOp op = std::get<LogicOp>(guard.value);
+        int64_t bound;
+        if ((op != LogicOp::LEQ && op != LogicOp::LE) || !is_constant(guard.children[1], bound)) return std::nullopt;
+
+        std::map<std::string, int> writes;
+        if (!count_writes(body, writes, false)) return std::nullopt;
+        CountedLoop loop;
+        loop.counter = std::get<std::string>(guard.children[0].value);
+        loop.limit = op == LogicOp::LE ? bound - 1 : bound;
+        std::vector<ASTNode> top = body.type == NodeType::SEQUENCE ? body.children : std::vector<ASTNode>{body};
+        for (const auto &statement : top) {
+            if (statement.type != NodeType::ASSIGNMENT || statement.children[0].type != NodeType::VARIABLE) continue;
+            const std::string &var = std::get<std::string>(statement.children[0].value);
+            auto d = increment_of(statement);
+            if (d && writes[var] == 1) loop.steps[var] = *d;
+        }
+        auto it = loop.steps.find(loop.counter);
+        if (it == loop.steps.end() || it->second <= 0) return std::nullopt;
+        return loop;
+    }
+
+    const std::string &get_counter() const { return counter; }
+    int64_t get_limit() const { return limit; }
+    const std::map<std::string, int64_t> &get_steps() const { return steps; }
+
+    // The interval of var at the head is the closed form, it is not widened.
+    bool accelerates(const std::string &var) const { return steps.count(var) != 0; }
+
+    // Values at the loop head, the guard holding. The stores are
+    // IntervalStores, or the flat ones of the generated analyzers.
+    template <typename S>
+    void accelerate_head(const S &entry, S &head) const {
+        Interval<int64_t> x0 = entry.get_interval(counter);
+        auto [least, most] = exit_trips(x0);
+        if (x0.isEmpty() || most == 0) {
+            head = S::bottom();   // the body never runs
+            return;
+        }
+        int64_t upper = std::min(x0.getUpper(), limit);
+        head.set_interval(counter, Interval<int64_t>(x0.getLower(), limit - residues(x0.getLower(), upper).first));
+        shift_inductions(entry, head, 0, most == pos_inf ? most : most - 1);
+    }
+
+    // Values once the guard fails, zero iterations included.
+    template <typename S>
+    void accelerate_exit(const S &entry, S &exit) const {
+        Interval<int64_t> x0 = entry.get_interval(counter);
+        if (x0.isEmpty()) return;
+        auto [least, most] = exit_trips(x0);
+        Interval<int64_t> x = Interval<int64_t>::build_empty();
+        if (most > 0) {
+            int64_t step = steps.at(counter);
+            auto [low, high] = residues(x0.getLower(), std::min(x0.getUpper(), limit));
+            x = Interval<int64_t>(clamp(Wide(limit) + step - high), clamp(Wide(limit) + step - low));
+        }
+        if (x0.getUpper() > limit) x = x.join(Interval<int64_t>(std::max(x0.getLower(), limit + 1), x0.getUpper()));
+        exit.set_interval(counter, x);
+        shift_inductions(entry, exit, least, most);
+    }
+
+    // Number of iterations, +oo when the entry interval of the counter is not bounded below.
+    Interval<int64_t> trip_count(const Interval<int64_t> &entry) const {
+        auto [least, most] = exit_trips(entry);
+        return Interval<int64_t>(clamp(least), clamp(most));
+    }
+};
+
+#endif
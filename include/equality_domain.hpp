@@ -0,0 +1,185 @@
+#ifndef EQUALITY_DOMAIN_HPP
+#define EQUALITY_DOMAIN_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "report.hpp"
+
+// Partition of the variables into classes of variables holding the same value.
+// Implemented as a union-find over variable IDs (slots) with path compression;
+// every class is also threaded on a circular list so that its members can be
+// enumerated without scanning the whole store.
+class EqualityDomain {
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    std::map<std::string, size_t> ids;  // variable -> slot
+    std::vector<size_t> parent;
+    std::vector<size_t> rank;
+    std::vector<size_t> next;           // circular list of the slots of a class
+    std::vector<std::string> owner;     // slot -> variable ("" once the slot is dead)
+    size_t dead = 0;                    // slots of no variable, see unlink
+
+    size_t new_slot(const std::string& var) {
+        size_t id = parent.size();
+        parent.push_back(id);
+        rank.push_back(0);
+        next.push_back(id);
+        owner.push_back(var);
+        ids[var] = id;
+        return id;
+    }
+
+    size_t slot_of(const std::string& var) {
+        auto it = ids.find(var);
+        return it != ids.end() ? it->second : new_slot(var);
+    }
+
+    // Non-const find compresses the path; the const one only walks it, so
+    // several readers can safely share a store.
+    size_t find(size_t id) {
+        size_t root = id;
+        while (parent[root] != root) root = parent[root];
+        while (parent[id] != root) {
+            size_t up = parent[id];
+            parent[id] = root;
+            id = up;
+        }
+        return root;
+    }
+
+    size_t find(size_t id) const {
+        while (parent[id] != id) id = parent[id];
+        return id;
+    }
+
+    // a and b are slots of variables: a root may be dead, out of the list.
+    void unite(size_t a, size_t b) {
+        size_t root_a = find(a), root_b = find(b);
+        if (root_a == root_b) return;
+        std::swap(next[a], next[b]);  // splice the two circular lists
+        if (rank[root_a] < rank[root_b]) std::swap(root_a, root_b);
+        parent[root_b] = root_a;
+        if (rank[root_a] == rank[root_b]) rank[root_a]++;
+    }
+
+    // Takes the slot of a variable leaving its class out of the circular
+    // list, so that class_of no longer walks it. It stays in the union-find
+    // tree, other slots may reach their root through it, until compact.
+    void unlink(size_t id) {
+        size_t prev = id;
+        while (next[prev] != id) prev = next[prev];
+        next[prev] = next[id];
+        next[id] = id;
+        owner[id].clear();
+        dead++;
+    }
+
+    // Rebuilds the partition on the slots of the variables alone, once the
+    // dead slots outnumber them.
+    void reclaim() {
+        if (dead <= ids.size()) return;
+        EqualityDomain compact;
+        std::map<size_t, size_t> classes;
+        for (const auto& [var, id] : ids) {
+            size_t slot = compact.new_slot(var);
+            auto inserted = classes.emplace(find(id), slot);
+            if (!inserted.second) compact.unite(inserted.first->second, slot);
+        }
+        *this = std::move(compact);
+    }
+
+    // Canonical form: every variable mapped to the smallest variable of its class.
+    std::vector<std::pair<std::string, std::string>> canonical() const {
+        std::map<size_t, std::string> first;
+        std::vector<std::pair<std::string, std::string>> result;
+        for (const auto& [var, id] : ids) {
+            auto inserted = first.emplace(find(id), var);
+            if (!inserted.second) result.emplace_back(var, inserted.first->second);
+        }
+        return result;
+    }
+
+public:
+    EqualityDomain() = default;
+
+    // `dst = src`: dst leaves its class and joins the one of src.
+    void assign(const std::string& dst, const std::string& src) {
+        if (dst == src) return;
+        forget(dst);
+        unite(slot_of(dst), slot_of(src));
+    }
+
+    // dst gets a fresh value: it leaves its class for a slot of its own.
+    void forget(const std::string& var) {
+        auto it = ids.find(var);
+        if (it == ids.end()) return;
+        if (next[it->second] == it->second) return;  // already alone
+        unlink(it->second);
+        new_slot(var);
+        reclaim();
+    }
+
+    // var goes out of scope: its slot leaves its class.
+    void remove(const std::string& var) {
+        auto it = ids.find(var);
+        if (it == ids.end()) return;
+        unlink(it->second);
+        ids.erase(it);
+        reclaim();
+    }
+
+    bool equal(const std::string& a, const std::string& b) const {
+        if (a == b) return true;
+        auto ia = ids.find(a), ib = ids.find(b);
+        if (ia == ids.end() || ib == ids.end()) return false;
+        return find(ia->second) == find(ib->second);
+    }
+
+    // All the variables equal to var (var included).
+    std::vector<std::string> class_of(const std::string& var) const {
+        auto it = ids.find(var);
+        if (it == ids.end()) return {var};
+        std::vector<std::string> members;
+        size_t id = it->second;
+        do {
+            if (!owner[id].empty()) members.push_back(owner[id]);
+            id = next[id];
+        } while (id != it->second);
+        return members;
+    }
+
+    // Two variables stay equal only if they are equal in both partitions.
+    EqualityDomain join(const EqualityDomain& other) const {
+        EqualityDomain result;
+        std::map<std::pair<size_t, size_t>, size_t> classes;
+        for (const auto& [var, id] : ids) {
+            auto it = other.ids.find(var);
+            if (it == other.ids.end()) continue;
+            size_t slot = result.new_slot(var);
+            auto key = std::make_pair(find(id), other.find(it->second));
+            auto inserted = classes.emplace(key, slot);
+            if (!inserted.second) result.unite(inserted.first->second, slot);
+        }
+        return result;
+    }
+
+    void print() const {
+        for (const auto& [var, rep] : canonical()) {
+            report_out() << var << " == " << rep << std::endl;
+        }
+    }
+
+    bool operator==(const EqualityDomain& other) const {
+        return canonical() == other.canonical();
+    }
+
+    bool operator!=(const EqualityDomain& other) const {
+        return !(*this == other);
+    }
+};
+
+#endif
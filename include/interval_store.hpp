@@ -2,20 +2,212 @@
 #ifndef INTERVAL_STORE_HPP
 #define INTERVAL_STORE_HPP
 
+#include <cmath>
 #include <map>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include "interval.hpp"
+#include "array_domain.hpp"
+#include "equality_domain.hpp"
+#include "affine_domain.hpp"
+#include "known_bits.hpp"
+#include "report.hpp"
 
 template <typename T>
 class IntervalStore {
 private:
     std::map<std::string, Interval<T>> intervals;
+    EqualityDomain equalities;
+    std::optional<AffineEqualityDomain> affine;  // Karr's domain, only when enabled
+    std::map<std::string, KnownBits> bits;       // only the bits not implied by the interval
+    std::map<std::string, ArrayValue> arrays;
+    bool unreachable = false;                    // bottom: no execution gets there
+
+    static long double to_bound(T value) {
+        if (value == std::numeric_limits<T>::lowest()) return -std::numeric_limits<long double>::infinity();
+        if (value == std::numeric_limits<T>::max()) return std::numeric_limits<long double>::infinity();
+        return static_cast<long double>(value);
+    }
+
+    // Reduction with the affine equalities: from sum(a_i * x_i) = c, every x_i
+    // lies in (c - sum_{j != i} a_j * x_j) / a_i.
+    void reduce() {
+        if (!affine) return;
+        constexpr long double eps = 1e-6L;
+        constexpr long double limit = 4611686018427387904.0L;  // 2^62
+        for (const auto& eq : affine->constraints()) {
+            for (const auto& [var, a] : eq.coeffs) {
+                auto it = intervals.find(var);
+                if (it == intervals.end()) continue;
+                long double lo = eq.constant.to_long_double(), hi = lo;
+                for (const auto& [other, b] : eq.coeffs) {
+                    if (other == var) continue;
+                    Interval<T> iv = get_interval(other);
+                    long double coef = b.to_long_double();
+                    if (coef > 0) { lo -= coef * to_bound(iv.getUpper()); hi -= coef * to_bound(iv.getLower()); }
+                    else { lo -= coef * to_bound(iv.getLower()); hi -= coef * to_bound(iv.getUpper()); }
+                }
+                long double coef = a.to_long_double();
+                if (coef < 0) std::swap(lo, hi);
+                lo /= coef;
+                hi /= coef;
+                T lower = it->second.getLower(), upper = it->second.getUpper();
+                if (std::isfinite(lo) && std::fabs(lo) < limit) lower = std::max(lower, static_cast<T>(std::ceil(lo - eps)));
+                if (std::isfinite(hi) && std::fabs(hi) < limit) upper = std::min(upper, static_cast<T>(std::floor(hi + eps)));
+                it->second = Interval<T>(lower, upper);
+            }
+        }
+    }
 
 public:
     IntervalStore() = default;
 
+    // Store of the program points no execution reaches (after a break), the
+    // neutral element of join.
+    static IntervalStore bottom() {
+        IntervalStore store;
+        store.unreachable = true;
+        return store;
+    }
+
+    bool is_bottom() const { return unreachable; }
+
+    // var receives a new value, it is no longer equal to any other variable.
     void update_interval(const std::string& var, const Interval<T>& interval) {
         intervals[var] = interval;
+        bits.erase(var);
+        equalities.forget(var);
+        if (affine) affine->forget(var);
+    }
+
+    // var goes out of scope, it leaves every component of the store.
+    void remove_variable(const std::string& var) {
+        intervals.erase(var);
+        arrays.erase(var);
+        bits.erase(var);
+        equalities.remove(var);
+        if (affine) affine->remove(var);
+    }
+
+    // `int var[size]`, its elements at top.
+    void declare_array(const std::string& var, int64_t size, size_t segments) {
+        remove_variable(var);
+        arrays.insert_or_assign(var, ArrayValue(size, Interval<int64_t>(), segments));
+    }
+
+    bool has_array(const std::string& var) const {
+        return arrays.find(var) != arrays.end();
+    }
+
+    const ArrayValue& get_array(const std::string& var) const {
+        auto it = arrays.find(var);
+        if (it == arrays.end()) throw std::runtime_error("`" + var + "` is not an array");
+        return it->second;
+    }
+
+    void set_array(const std::string& var, const ArrayValue& value) {
+        arrays.insert_or_assign(var, value);
+    }
+
+    std::vector<std::string> get_arrays() const {
+        std::vector<std::string> vars;
+        for (const auto& [var, value] : arrays) vars.push_back(var);
+        return vars;
+    }
+
+    // `var[index] = value`, nothing when var is not in the store (pruned).
+    void write_array(const std::string& var, const Interval<T>& index, const Interval<T>& value) {
+        auto it = arrays.find(var);
+        if (it != arrays.end()) it->second.write(index, value);
+    }
+
+    // Loop heads: the elements growing since `old` are widened.
+    void widen_arrays(const IntervalStore& old) {
+        for (auto& [var, value] : arrays) {
+            auto it = old.arrays.find(var);
+            if (it != old.arrays.end() && it->second.get_size() == value.get_size()) value = value.widen(it->second);
+        }
+    }
+
+    // `dst = src`: dst takes the interval of src and joins its equality class.
+    void assign_variable(const std::string& dst, const std::string& src) {
+        intervals[dst] = get_interval(src);
+        auto it = bits.find(src);
+        if (it != bits.end()) bits[dst] = it->second;
+        else bits.erase(dst);
+        equalities.assign(dst, src);
+        if (affine) affine->assign(dst, AffineExpr{{{src, Rational(1)}}, Rational(0)});
+    }
+
+    // `var = expr` for an affine expr whose interval evaluation is `interval`.
+    void assign_affine(const std::string& var, const AffineExpr& expr, const Interval<T>& interval) {
+        intervals[var] = interval;
+        bits.erase(var);
+        equalities.forget(var);
+        if (!affine) return;
+        affine->assign(var, expr);
+        reduce();
+    }
+
+    // Reduced product with the known bits of var: the interval is narrowed to the
+    // values the bits allow, and the bits are only kept if the interval alone
+    // does not imply them.
+    void update_bits(const std::string& var, const KnownBits& known) {
+        Interval<T> interval = get_interval(var).meet(known.template to_interval<T>());
+        intervals[var] = interval;
+        KnownBits implied = KnownBits::from_interval(interval);
+        KnownBits reduced = known.meet(implied);
+        if (reduced != implied) bits[var] = reduced;
+        else bits.erase(var);
+    }
+
+    KnownBits get_bits(const std::string& var) const {
+        KnownBits implied = KnownBits::from_interval(get_interval(var));
+        auto it = bits.find(var);
+        return it != bits.end() ? it->second.meet(implied) : implied;
+    }
+
+    bool has_known_bits() const {
+        return !bits.empty();
+    }
+
+    void enable_affine_equalities() {
+        affine.emplace();
+        for (const auto& [var, interval] : intervals) affine->add(var);
+    }
+
+    bool has_affine_equalities() const {
+        return affine.has_value();
+    }
+
+    // Guard refinement: var and all the variables equal to it are narrowed.
+    void refine_interval(const std::string& var, const Interval<T>& interval) {
+        for (const auto& member : equalities.class_of(var)) {
+            intervals[member] = interval.meet(get_interval(member));
+        }
+        reduce();
+    }
+
+    // The closed form of a counted loop for var: var leaves its equality class,
+    // whose other members keep their own values, and its known bits. Its
+    // affine equalities are kept, the loop is iterated until they hold.
+    void set_interval(const std::string& var, const Interval<T>& interval) {
+        intervals[var] = interval;
+        bits.erase(var);
+        equalities.forget(var);
+    }
+
+    // Over-approximates the interval of var (widening) without breaking its equalities.
+    void widen_interval(const std::string& var, const Interval<T>& interval) {
+        for (const auto& member : equalities.class_of(var)) {
+            intervals[member] = interval;
+        }
+    }
+
+    const EqualityDomain& get_equalities() const {
+        return equalities;
     }
 
     Interval<T> get_interval(const std::string& var) const {
@@ -26,11 +218,42 @@ public:
         return Interval<T>(); // Return top interval
     }
 
+    std::vector<std::string> get_variables() const {
+        std::vector<std::string> vars;
+        for (const auto& [var, interval] : intervals) vars.push_back(var);
+        return vars;
+    }
+
+    // Visits, in name order, the variables whose interval differs from the
+    // one in `before`: visit(var, &interval), or visit(var, nullptr) for the
+    // ones only `before` has. One walk of both maps, without copying them.
+    template <typename Visit>
+    void for_each_changed_interval(const IntervalStore& before, Visit visit) const {
+        auto a = before.intervals.begin(), b = intervals.begin();
+        while (a != before.intervals.end() || b != intervals.end()) {
+            if (b == intervals.end() || (a != before.intervals.end() && a->first < b->first)) {
+                visit(a->first, nullptr);
+                ++a;
+            }
+            else if (a == before.intervals.end() || b->first < a->first) {
+                visit(b->first, &b->second);
+                ++b;
+            }
+            else {
+                if (a->second != b->second || a->second.isEmpty() != b->second.isEmpty()) visit(b->first, &b->second);
+                ++a;
+                ++b;
+            }
+        }
+    }
+
     bool has_variable(const std::string& var) const {
         return intervals.find(var) != intervals.end();
     }
 
     IntervalStore join(const IntervalStore& other) const {
+        if (unreachable) return other;
+        if (other.unreachable) return *this;
         IntervalStore result;
         // Join all variables from both stores
         for (const auto& [var, interval] : intervals) {
@@ -46,26 +269,60 @@ public:
                 result.update_interval(var, interval);
             }
         }
+        for (const auto& [var, known] : bits) {
+            if (other.has_variable(var)) result.bits[var] = get_bits(var).join(other.get_bits(var));
+        }
+        for (const auto& [var, known] : other.bits) {
+            if (has_variable(var) && !bits.count(var)) result.bits[var] = get_bits(var).join(other.get_bits(var));
+        }
+        for (auto it = result.bits.begin(); it != result.bits.end();) {
+            KnownBits implied = KnownBits::from_interval(result.get_interval(it->first));
+            it->second = it->second.meet(implied);
+            if (it->second == implied) it = result.bits.erase(it);
+            else ++it;
+        }
+        for (const auto& [var, value] : arrays) {
+            auto it = other.arrays.find(var);
+            result.arrays.insert_or_assign(var, it != other.arrays.end() ? value.join(it->second) : value);
+        }
+        for (const auto& [var, value] : other.arrays)
+            if (!has_array(var)) result.arrays.insert_or_assign(var, value);
+        result.equalities = equalities.join(other.equalities);
+        if (affine && other.affine) {
+            result.affine = affine->join(*other.affine);
+            result.reduce();
+        }
         return result;
     }
 
     void clear() {
         intervals.clear();
+        arrays.clear();
+        bits.clear();
+        equalities = EqualityDomain();
+        if (affine) affine.emplace();
     }
 
     void print() const {
+        if (unreachable) report_out() << "unreachable" << std::endl;
         for (const auto& [var, interval] : intervals) {
-            std::cout << var << " = [" << interval.getLower() 
+            report_out() << var << " = [" << interval.getLower() 
                      << ", " << interval.getUpper() << "]" << std::endl;
         }
+        for (const auto& [var, known] : bits) {
+            report_out() << var << " bits " << known << std::endl;
+        }
+        for (const auto& [var, value] : arrays) value.print(var);
+        equalities.print();
+        if (affine) affine->print();
     }
 
     bool operator==(const IntervalStore& other) const {
-        return intervals == other.intervals;
+        return unreachable == other.unreachable && intervals == other.intervals && arrays == other.arrays && bits == other.bits && equalities == other.equalities && affine == other.affine;
     }
 
     bool operator!=(const IntervalStore& other) const {
-        return intervals != other.intervals;
+        return !(*this == other);
     }
 };
 
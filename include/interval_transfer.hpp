@@ -0,0 +1,225 @@
+#ifndef INTERVAL_TRANSFER_HPP
+#define INTERVAL_TRANSFER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "ast.hpp"
+#include "interval.hpp"
+
+// The interval transfer functions of the operators, shared by the interpreter
+// (abstract_interpeter.hpp) and the analyzers generated for a program
+// (specialized_analyzer.hpp), so that both compute the same fixpoint.
+
+// Saturating bound arithmetic, lowest()/max() of T standing for -oo/+oo.
+template <typename T>
+T saturating_bound_sum(T a, T b) {
+    constexpr T neg_inf = std::numeric_limits<T>::lowest(), pos_inf = std::numeric_limits<T>::max();
+    if (a == neg_inf || b == neg_inf) return (a == pos_inf || b == pos_inf) ? pos_inf : neg_inf;
+    if (a == pos_inf || b == pos_inf) return pos_inf;
+    T r;
+    if (__builtin_add_overflow(a, b, &r)) return a > 0 ? pos_inf : neg_inf;
+    return r;
+}
+
+template <typename T>
+T saturating_bound_product(T a, T b) {
+    constexpr T neg_inf = std::numeric_limits<T>::lowest(), pos_inf = std::numeric_limits<T>::max();
+    if (a == 0 || b == 0) return 0;
+    bool negative = (a < 0) != (b < 0);
+    T r;
+    if (a == neg_inf || a == pos_inf || b == neg_inf || b == pos_inf || __builtin_mul_overflow(a, b, &r)) return negative ? neg_inf : pos_inf;
+    return r;
+}
+
+template <typename T>
+Interval<T> saturating_sum(const Interval<T>& a, const Interval<T>& b) {
+    constexpr T neg_inf = std::numeric_limits<T>::lowest(), pos_inf = std::numeric_limits<T>::max();
+    T lower = saturating_bound_sum(a.getLower(), b.getLower());
+    T upper = saturating_bound_sum(a.getUpper(), b.getUpper());
+    // -oo + +oo on a bound: give up on that bound.
+    if ((a.getLower() == neg_inf && b.getLower() == pos_inf) || (a.getLower() == pos_inf && b.getLower() == neg_inf)) lower = neg_inf;
+    if ((a.getUpper() == neg_inf && b.getUpper() == pos_inf) || (a.getUpper() == pos_inf && b.getUpper() == neg_inf)) upper = pos_inf;
+    return Interval<T>(lower, upper);
+}
+
+template <typename T>
+Interval<T> saturating_difference(const Interval<T>& a, const Interval<T>& b) {
+    constexpr T neg_inf = std::numeric_limits<T>::lowest(), pos_inf = std::numeric_limits<T>::max();
+    auto negate = [](T bound) { return bound == neg_inf ? pos_inf : bound == pos_inf ? neg_inf : -bound; };
+    return saturating_sum(a, Interval<T>(negate(b.getUpper()), negate(b.getLower())));
+}
+
+template <typename T>
+Interval<T> saturating_product(const Interval<T>& a, const Interval<T>& b) {
+    T c[4] = {saturating_bound_product(a.getLower(), b.getLower()), saturating_bound_product(a.getLower(), b.getUpper()),
+              saturating_bound_product(a.getUpper(), b.getLower()), saturating_bound_product(a.getUpper(), b.getUpper())};
+    return Interval<T>(std::min({c[0], c[1], c[2], c[3]}), std::max({c[0], c[1], c[2], c[3]}));
+}
+
+// `left op right` for + - * / %, without the overflow warnings: a divisor
+// that may be 0 gives top. The bitwise operators need the known bits.
+Interval<int64_t> interval_arithmetic(BinOp op, const Interval<int64_t>& left, const Interval<int64_t>& right)
+{
+    switch (op)
+    {
+        // An infinite bound stays infinite instead of wrapping around.
+        case BinOp::ADD:
+            return saturating_sum(left, right);
+        case BinOp::SUB:
+            return saturating_difference(left, right);
+        case BinOp::MUL:
+            return saturating_product(left, right);
+        case BinOp::DIV:
+            if (right.contains(0)) return Interval<int64_t>();
+            return left / right;
+        case BinOp::MOD:
+        {
+            if (right.contains(0)) return Interval<int64_t>();
+            // |left % right| < |right| and the sign of the result is the one of left.
+            int64_t min_abs = right.getLower() > 0 ? right.getLower() : -right.getUpper();
+            int64_t max_abs = right.getLower() > 0 ? right.getUpper()
+                : right.getLower() == std::numeric_limits<int64_t>::lowest() ? std::numeric_limits<int64_t>::max() : -right.getLower();
+            if (left.getLower() >= 0 && left.getUpper() < min_abs) return left;
+            if (left.getUpper() <= 0 && left.getLower() > -min_abs) return left;
+            return Interval<int64_t>(
+                left.getLower() < 0 ? std::max(left.getLower(), 1 - max_abs) : 0,
+                left.getUpper() > 0 ? std::min(left.getUpper(), max_abs - 1) : 0
+            );
+        }
+        default:
+            return Interval<int64_t>();
+    }
+}
+
+// The comparisons work on 32-bit bounds, -oo/+oo becoming the int32 limits.
+int32_t comparison_lower(const Interval<int64_t>& iv)
+{
+    return static_cast<int32_t>(iv.getLower() == std::numeric_limits<int64_t>::lowest() ? std::numeric_limits<int32_t>::lowest() : iv.getLower());
+}
+
+int32_t comparison_upper(const Interval<int64_t>& iv)
+{
+    return static_cast<int32_t>(iv.getUpper() == std::numeric_limits<int64_t>::max() ? std::numeric_limits<int32_t>::max() : iv.getUpper());
+}
+
+// The values of `left` for which `left op right` may hold.
+Interval<int64_t> interval_comparison(LogicOp op, const Interval<int64_t>& left, const Interval<int64_t>& right)
+{
+    int32_t left_lower = comparison_lower(left), right_lower = comparison_lower(right);
+    int32_t left_upper = comparison_upper(left), right_upper = comparison_upper(right);
+
+    switch (op)
+    {
+    case LogicOp::EQ:
+        // Return the intersection of the intervals
+        return Interval<int64_t>(
+            std::max(left_lower, right_lower),
+            std::min(left_upper, right_upper)
+        );
+
+    case LogicOp::NEQ:
+        {
+            Interval<int64_t> intersection(
+                std::max(left_lower, right_lower),
+                std::min(left_upper, right_upper)
+            );
+
+            // If the intervals overlap by exactly one value and that value equals
+            // the entire left interval, return empty; otherwise keep the left interval.
+            if (intersection.getLower() == intersection.getUpper() &&
+                left.getLower() == left.getUpper() &&
+                intersection.getLower() == left.getLower())
+            {
+                return Interval<int64_t>::build_empty();
+            }
+            // If there's more than one point to exclude (would split the interval),
+            // or no overlap, just keep the original left interval as an approximation.
+            return left;
+        }
+
+    case LogicOp::LE:
+        // x < y: Return all x values that are less than the maximum y
+        return Interval<int64_t>(
+            left_lower,
+            left_upper < right_upper ? left_upper : right_upper - 1
+        );
+
+    case LogicOp::LEQ:
+        // x <= y: Return all x values that are less than or equal to the maximum y
+        return Interval<int64_t>(
+            left_lower,
+            left_upper < right_upper ? left_upper : right_upper
+        );
+
+    case LogicOp::GE:
+        // x > y: Return all x values that are greater than the minimum y
+        return Interval<int64_t>(
+            left_lower > right_lower ? left_lower : right_lower + 1,
+            left_upper
+        );
+
+    case LogicOp::GEQ:
+        // x >= y: Return all x values that are greater than or equal to the minimum y
+        return Interval<int64_t>(
+            left_lower > right_lower ? left_lower : right_lower,
+            left_upper
+        );
+
+    default:
+        throw std::runtime_error("Unsupported logical operation");
+    }
+}
+
+// `left op right` used as an operand, as in `x & 1 == 0`: 1 where it holds, 0
+// where it fails, so [0, 1] unless the intervals decide it.
+Interval<int64_t> comparison_value(LogicOp op, const Interval<int64_t>& left, const Interval<int64_t>& right)
+{
+    if (left.isEmpty() || right.isEmpty()) return Interval<int64_t>::build_empty();
+    int64_t left_lower = left.getLower(), left_upper = left.getUpper();
+    int64_t right_lower = right.getLower(), right_upper = right.getUpper();
+    bool single = left_lower == left_upper && right_lower == right_upper && left_lower == right_lower;
+    bool overlap = left_lower <= right_upper && right_lower <= left_upper;
+    bool holds, fails;   // whether it may hold, may fail
+    switch (op)
+    {
+    case LogicOp::LE: holds = left_lower < right_upper; fails = left_upper >= right_lower; break;
+    case LogicOp::LEQ: holds = left_lower <= right_upper; fails = left_upper > right_lower; break;
+    case LogicOp::GE: holds = left_upper > right_lower; fails = left_lower <= right_upper; break;
+    case LogicOp::GEQ: holds = left_upper >= right_lower; fails = left_lower < right_upper; break;
+    case LogicOp::EQ: holds = overlap; fails = !single; break;
+    case LogicOp::NEQ: holds = !single; fails = overlap; break;
+    default: throw std::runtime_error("Unsupported logical operation");
+    }
+    return Interval<int64_t>(holds && !fails ? 1 : 0, holds ? 1 : 0);
+}
+
+// Loop heads: bounds growing past old_iv jump to the closest threshold, or to
+// +/-oo when `to_infinity` (without it they are left as joined).
+Interval<int64_t> widen_to_thresholds(const Interval<int64_t> &old_iv, const Interval<int64_t> &joined_iv, const std::vector<int64_t> &thresholds, bool to_infinity)
+{
+    int64_t widened_lower = old_iv.getLower();
+    int64_t widened_upper = old_iv.getUpper();
+    if (old_iv.getLower() > joined_iv.getLower()) {
+        widened_lower = to_infinity ? std::numeric_limits<int64_t>::lowest() : joined_iv.getLower();
+        int64_t best = std::numeric_limits<int64_t>::lowest();
+        bool found = false;
+        for (int64_t t : thresholds)
+            if (t <= joined_iv.getLower() && (!found || t > best)) { best = t; found = true; }
+        if (found) widened_lower = best;
+    }
+    if (old_iv.getUpper() < joined_iv.getUpper()) {
+        widened_upper = to_infinity ? std::numeric_limits<int64_t>::max() : joined_iv.getUpper();
+        int64_t best = std::numeric_limits<int64_t>::max();
+        bool found = false;
+        for (int64_t t : thresholds)
+            if (t >= joined_iv.getUpper() && (!found || t < best)) { best = t; found = true; }
+        if (found) widened_upper = best;
+    }
+    return Interval<int64_t>(widened_lower, widened_upper);
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef ITERATION_HISTORY_HPP
+#define ITERATION_HISTORY_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "interval.hpp"
+#include "interval_store.hpp"
+
+// Binary log of the evolution of the stores during eval_all: for every
+// location whose store changed, only the variables whose interval changed,
+// with their new bounds, and the ones it dropped. Integers are LEB128
+// varints, the signed ones zigzag-encoded first:
+//   "AIHIST01"
+//   'V' id length name                       a variable, before its first use
+//   'I' n                                    iteration n - 1 starts, 0 for the initial stores
+//   'L' location flags count (id kind [lower] [upper])*
+// flags: 1 = the store is unreachable. kind: 1 = lower is -oo, 2 = upper is
+// +oo, 4 = removed, 8 = empty; the infinite bounds are not written.
+// The relational components and the arrays are not recorded.
+namespace history {
+constexpr char magic[] = "AIHIST01";
+constexpr uint8_t unreachable = 1;
+constexpr uint8_t lower_infinite = 1, upper_infinite = 2, removed = 4, empty = 8;
+}
+
+class HistoryRecorder {
+private:
+    std::ofstream out;
+    std::unordered_map<std::string, uint64_t> ids;
+    const IntervalStore<int64_t> none;   // the empty store, before the initial ones
+    std::string record, entries;         // the location record being built
+
+    static void put_varint(std::string &buffer, uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    static void put_signed(std::string &buffer, int64_t value) {
+        put_varint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    uint64_t id_of(const std::string &var) {
+        auto it = ids.find(var);
+        if (it != ids.end()) return it->second;
+        uint64_t id = ids.size();
+        ids.emplace(var, id);
+        std::string definition(1, 'V');
+        put_varint(definition, id);
+        put_varint(definition, var.size());
+        definition += var;
+        out.write(definition.data(), static_cast<std::streamsize>(definition.size()));
+        return id;
+    }
+
+    static void put_interval(std::string &buffer, uint64_t id, const Interval<int64_t> &iv) {
+        put_varint(buffer, id);
+        if (iv.isEmpty()) {
+            buffer.push_back(static_cast<char>(history::empty));
+            return;
+        }
+        bool low_inf = iv.getLower() == std::numeric_limits<int64_t>::lowest();
+        bool high_inf = iv.getUpper() == std::numeric_limits<int64_t>::max();
+        buffer.push_back(static_cast<char>((low_inf ? history::lower_infinite : 0) | (high_inf ? history::upper_infinite : 0)));
+        if (!low_inf) put_signed(buffer, iv.getLower());
+        if (!high_inf) put_signed(buffer, iv.getUpper());
+    }
+
+public:
+    explicit HistoryRecorder(const std::string &path) : out(path, std::ios::binary) {
+        if (!out.is_open()) throw std::runtime_error("cannot write the history `" + path + "`");
+        out.write(history::magic, sizeof(history::magic) - 1);
+    }
+
+    // Before the first iteration, the initial stores are iteration -1.
+    void begin_iteration(int64_t iteration) {
+        std::string header(1, 'I');
+        put_varint(header, static_cast<uint64_t>(iteration + 1));
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    }
+
+    // Delta of the store of `location`, from `before` (its last recorded
+    // store) to `after`: only the variables whose interval changed are
+    // visited, the unchanged ones cost one comparison each.
+    void record_store(size_t location, const IntervalStore<int64_t> &before, const IntervalStore<int64_t> &after) {
+        record.assign(1, 'L');
+        put_varint(record, location);
+        size_t count = 0;
+        entries.clear();
+        if (after.is_bottom()) {
+            if (before.is_bottom()) return;
+            record.push_back(static_cast<char>(history::unreachable));
+        }
+        else {
+            // After an unreachable store, every variable is written again.
+            after.for_each_changed_interval(before.is_bottom() ? none : before,
+                [&](const std::string &var, const Interval<int64_t> *iv) {
+                    uint64_t id = id_of(var);
+                    if (iv != nullptr) put_interval(entries, id, *iv);
+                    else {
+                        put_varint(entries, id);
+                        entries.push_back(static_cast<char>(history::removed));
+                    }
+                    count++;
+                });
+            if (count == 0 && !before.is_bottom()) return;
+            record.push_back(0);
+        }
+        put_varint(record, count);
+        record += entries;
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+    }
+
+    // The initial store of `location`, a delta from the empty store.
+    void record_store(size_t location, const IntervalStore<int64_t> &store) {
+        record_store(location, none, store);
+    }
+
+    bool close() {
+        out.close();
+        return !out.fail();
+    }
+};
+
+// Replays a history log: the store of a location at the end of an iteration,
+// and how many variables changed at every iteration.
+class HistoryReader {
+private:
+    std::string data;
+    size_t pos = 0;
+
+    uint8_t get_byte() {
+        if (pos >= data.size()) throw std::runtime_error("truncated history");
+        return static_cast<uint8_t>(data[pos++]);
+    }
+
+    uint64_t get_varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = get_byte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        throw std::runtime_error("invalid varint in the history");
+    }
+
+    int64_t get_signed() {
+        uint64_t value = get_varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Visits the log: `iteration` on every 'I', `location` on every 'L'
+    // with its flags and its entries (id, kind, interval); stops when a
+    // visitor returns false.
+    template <typename OnIteration, typename OnLocation>
+    void replay(std::vector<std::string> &names, OnIteration on_iteration, OnLocation on_location) {
+        pos = sizeof(history::magic) - 1;
+        std::vector<std::pair<uint64_t, std::pair<uint8_t, Interval<int64_t>>>> entries;
+        while (pos < data.size()) {
+            char tag = static_cast<char>(get_byte());
+            if (tag == 'V') {
+                uint64_t id = get_varint();
+                uint64_t length = get_varint();
+                if (length > data.size() - pos) throw std::runtime_error("truncated history");
+                if (id >= names.size()) names.resize(id + 1);
+                names[id] = data.substr(pos, length);
+                pos += length;
+            }
+            else if (tag == 'I') {
+                if (!on_iteration(static_cast<int64_t>(get_varint()) - 1)) return;
+            }
+            else if (tag == 'L') {
+                uint64_t location = get_varint();
+                uint8_t flags = get_byte();
+                uint64_t count = get_varint();
+                entries.clear();
+                for (uint64_t k = 0; k < count; ++k) {
+                    uint64_t id = get_varint();
+                    uint8_t kind = get_byte();
+                    int64_t lower = std::numeric_limits<int64_t>::lowest(), upper = std::numeric_limits<int64_t>::max();
+                    if ((kind & (history::removed | history::empty)) == 0) {
+                        if (!(kind & history::lower_infinite)) lower = get_signed();
+                        if (!(kind & history::upper_infinite)) upper = get_signed();
+                    }
+                    Interval<int64_t> iv = kind & history::empty ? Interval<int64_t>::build_empty() : Interval<int64_t>(lower, upper);
+                    entries.push_back({id, {kind, iv}});
+                }
+                on_location(location, flags, entries);
+            }
+            else throw std::runtime_error("invalid record in the history");
+        }
+    }
+
+public:
+    explicit HistoryReader(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) throw std::runtime_error("cannot read the history `" + path + "`");
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (data.compare(0, sizeof(history::magic) - 1, history::magic) != 0)
+            throw std::runtime_error("`" + path + "` is not a history log");
+    }
+
+    // The store of `location` at the end of `iteration` (-1: its initial
+    // store), or at the end of the last iteration when `iteration` is past it.
+    IntervalStore<int64_t> store_at(size_t location, int64_t iteration) {
+        std::vector<std::string> names;
+        std::map<uint64_t, Interval<int64_t>> intervals;
+        bool unreachable = false;
+        replay(names,
+            [&](int64_t n) { return n <= iteration; },
+            [&](uint64_t loc, uint8_t flags, const auto &entries) {
+                if (loc != location) return;
+                unreachable = flags & history::unreachable;
+                if (unreachable) intervals.clear();
+                for (const auto &[id, change] : entries) {
+                    if (change.first & history::removed) intervals.erase(id);
+                    else intervals[id] = change.second;
+                }
+            });
+        if (unreachable) return IntervalStore<int64_t>::bottom();
+        IntervalStore<int64_t> store;
+        for (const auto &[id, iv] : intervals) store.update_interval(names.at(id), iv);
+        return store;
+    }
+
+    // For every iteration from -1 on: the locations and the variables changed.
+    std::vector<std::pair<size_t, size_t>> changes() {
+        std::vector<std::string> names;
+        std::vector<std::pair<size_t, size_t>> counts;
+        replay(names,
+            [&](int64_t) { counts.emplace_back(0, 0); return true; },
+            [&](uint64_t, uint8_t, const auto &entries) {
+                if (counts.empty()) throw std::runtime_error("location record before the first iteration");
+                counts.back().first++;
+                counts.back().second += entries.size();
+            });
+        return counts;
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef KNOWN_BITS_HPP
+#define KNOWN_BITS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include "interval.hpp"
+
+// Tristate abstraction of a 64-bit two's complement value: every bit is known
+// to be 0, known to be 1, or unknown. All the transfer functions are O(1) on
+// machine words, except the shifts by a non-constant amount (at most 64 steps).
+class KnownBits {
+private:
+    uint64_t zeros = 0;  // bits known to be 0
+    uint64_t ones = 0;   // bits known to be 1
+
+    static constexpr uint64_t sign_bit = uint64_t(1) << 63;
+
+    KnownBits(uint64_t zeros, uint64_t ones) : zeros(zeros), ones(ones) {}
+
+    static unsigned trailing_zeros(uint64_t known_zeros) {
+        return known_zeros == ~uint64_t(0) ? 64 : __builtin_ctzll(~known_zeros);
+    }
+
+    // a + b + carry, carry being either known (0 or 1).
+    static KnownBits add_carry(const KnownBits& a, const KnownBits& b, bool carry) {
+        uint64_t possible_sum_zero = ~a.zeros + ~b.zeros + (carry ? 1 : 0);
+        uint64_t possible_sum_one = a.ones + b.ones + (carry ? 1 : 0);
+        uint64_t carry_known_zero = ~(possible_sum_zero ^ a.zeros ^ b.zeros);
+        uint64_t carry_known_one = possible_sum_one ^ a.ones ^ b.ones;
+        uint64_t known = (a.zeros | a.ones) & (b.zeros | b.ones) & (carry_known_zero | carry_known_one);
+        return KnownBits(~possible_sum_zero & known, possible_sum_one & known);
+    }
+
+public:
+    KnownBits() = default;
+
+    static KnownBits top() { return KnownBits(); }
+
+    static KnownBits constant(int64_t value) {
+        return KnownBits(~static_cast<uint64_t>(value), static_cast<uint64_t>(value));
+    }
+
+    // The bits shared by all the values of [lower, upper].
+    template <typename T>
+    static KnownBits from_interval(const Interval<T>& iv) {
+        if (iv.getLower() == std::numeric_limits<T>::lowest() || iv.getUpper() == std::numeric_limits<T>::max() || iv.isEmpty())
+            return top();
+        uint64_t lo = static_cast<uint64_t>(static_cast<int64_t>(iv.getLower()));
+        uint64_t hi = static_cast<uint64_t>(static_cast<int64_t>(iv.getUpper()));
+        uint64_t diff = lo ^ hi;
+        if (diff == 0) return constant(static_cast<int64_t>(lo));
+        unsigned highest = 63 - __builtin_clzll(diff);
+        uint64_t known = highest == 63 ? 0 : ~((uint64_t(2) << highest) - 1);
+        return KnownBits(~lo & known, lo & known);
+    }
+
+    template <typename T>
+    Interval<T> to_interval() const {
+        uint64_t unknown = ~(zeros | ones);
+        int64_t lower = static_cast<int64_t>(ones | (unknown & sign_bit));
+        int64_t upper = static_cast<int64_t>((ones | unknown) & ~(unknown & sign_bit));
+        return Interval<T>(static_cast<T>(lower), static_cast<T>(upper));
+    }
+
+    bool is_top() const { return (zeros | ones) == 0; }
+    bool is_constant() const { return (zeros | ones) == ~uint64_t(0); }
+    int64_t get_constant() const { return static_cast<int64_t>(ones); }
+
+    KnownBits join(const KnownBits& other) const {
+        return KnownBits(zeros & other.zeros, ones & other.ones);
+    }
+
+    KnownBits meet(const KnownBits& other) const {
+        return KnownBits(zeros | other.zeros, ones | other.ones);
+    }
+
+    KnownBits operator&(const KnownBits& other) const {
+        return KnownBits(zeros | other.zeros, ones & other.ones);
+    }
+
+    KnownBits operator|(const KnownBits& other) const {
+        return KnownBits(zeros & other.zeros, ones | other.ones);
+    }
+
+    KnownBits operator^(const KnownBits& other) const {
+        return KnownBits((zeros & other.zeros) | (ones & other.ones), (zeros & other.ones) | (ones & other.zeros));
+    }
+
+    KnownBits operator+(const KnownBits& other) const {
+        return add_carry(*this, other, false);
+    }
+
+    // a - b = a + ~b + 1
+    KnownBits operator-(const KnownBits& other) const {
+        return add_carry(*this, KnownBits(other.ones, other.zeros), true);
+    }
+
+    // Only the trailing zeros of a product are known in general.
+    KnownBits operator*(const KnownBits& other) const {
+        if (is_constant() && other.is_constant())
+            return constant(static_cast<int64_t>(ones * other.ones));
+        unsigned tz = trailing_zeros(zeros) + trailing_zeros(other.zeros);
+        return KnownBits(tz >= 64 ? ~uint64_t(0) : (uint64_t(1) << tz) - 1, 0);
+    }
+
+    KnownBits shl(unsigned k) const {
+        if (k >= 64) return constant(0);
+        return KnownBits((zeros << k) | ((uint64_t(1) << k) - 1), ones << k);
+    }
+
+    // Arithmetic shift: the sign bit, known or not, is replicated.
+    KnownBits shr(unsigned k) const {
+        if (k > 63) k = 63;
+        return KnownBits(static_cast<uint64_t>(static_cast<int64_t>(zeros) >> k),
+                         static_cast<uint64_t>(static_cast<int64_t>(ones) >> k));
+    }
+
+    // Shift by any amount of [lower, upper], top when the shift is undefined.
+    template <typename T>
+    KnownBits shift(const Interval<T>& amount, bool left) const {
+        if (amount.getLower() < 0 || amount.getUpper() > 63) return top();
+        KnownBits result = left ? shl(amount.getLower()) : shr(amount.getLower());
+        for (T k = amount.getLower() + 1; k <= amount.getUpper(); ++k)
+            result = result.join(left ? shl(k) : shr(k));
+        return result;
+    }
+
+    bool operator==(const KnownBits& other) const {
+        return zeros == other.zeros && ones == other.ones;
+    }
+
+    bool operator!=(const KnownBits& other) const {
+        return !(*this == other);
+    }
+
+    // Prints the bits below the highest unknown one, e.g. `...??10`.
+    friend std::ostream& operator<<(std::ostream& os, const KnownBits& kb) {
+        uint64_t unknown = ~(kb.zeros | kb.ones);
+        int top_bit = unknown == 0 ? 0 : 63 - __builtin_clzll(unknown);
+        os << "...";
+        for (int i = std::min(top_bit + 1, 63); i >= 0; --i) {
+            uint64_t bit = uint64_t(1) << i;
+            os << ((unknown & bit) ? '?' : (kb.ones & bit) ? '1' : '0');
+        }
+        return os;
+    }
+};
+
+#endif
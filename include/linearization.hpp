@@ -0,0 +1,83 @@
+#ifndef LINEARIZATION_HPP
+#define LINEARIZATION_HPP
+
+#include <map>
+#include <string>
+#include "interval.hpp"
+#include "interval_store.hpp"
+#include "interval_transfer.hpp"
+
+// Quasi-linear form sum([a_i, b_i] * x_i) + [c, d] of an arithmetic expression.
+// Keeping the variables symbolic lets `a - a` or `(a + a) / 2` cancel before the
+// intervals are evaluated. The bounds lowest()/max() of T stand for -oo/+oo.
+template <typename T>
+class QuasiLinearForm {
+private:
+    std::map<std::string, Interval<T>> coeffs;
+    Interval<T> constant;
+
+    static constexpr T neg_inf = std::numeric_limits<T>::lowest();
+    static constexpr T pos_inf = std::numeric_limits<T>::max();
+
+    static bool is_inf(T v) { return v == neg_inf || v == pos_inf; }
+
+    static Interval<T> add(const Interval<T>& a, const Interval<T>& b) { return saturating_sum(a, b); }
+    static Interval<T> mul(const Interval<T>& a, const Interval<T>& b) { return saturating_product(a, b); }
+
+    static bool is_zero(const Interval<T>& iv) {
+        return iv.getLower() == 0 && iv.getUpper() == 0;
+    }
+
+public:
+    QuasiLinearForm() : constant(0, 0) {}
+    explicit QuasiLinearForm(const Interval<T>& constant) : constant(constant) {}
+    explicit QuasiLinearForm(const std::string& var) : constant(0, 0) {
+        coeffs.emplace(var, Interval<T>(1, 1));
+    }
+
+    bool is_constant() const { return coeffs.empty(); }
+    const Interval<T>& get_constant() const { return constant; }
+
+    QuasiLinearForm operator+(const QuasiLinearForm& other) const {
+        QuasiLinearForm result = *this;
+        for (const auto& [var, coef] : other.coeffs) {
+            auto it = result.coeffs.find(var);
+            if (it == result.coeffs.end()) result.coeffs.emplace(var, coef);
+            else if (is_zero(it->second = add(it->second, coef))) result.coeffs.erase(it);
+        }
+        result.constant = add(constant, other.constant);
+        return result;
+    }
+
+    QuasiLinearForm operator-(const QuasiLinearForm& other) const {
+        return *this + other.scale(Interval<T>(-1, -1));
+    }
+
+    QuasiLinearForm scale(const Interval<T>& factor) const {
+        QuasiLinearForm result;
+        if (is_zero(factor)) return result;
+        for (const auto& [var, coef] : coeffs) result.coeffs.emplace(var, mul(coef, factor));
+        result.constant = mul(constant, factor);
+        return result;
+    }
+
+    // Exact integer division by k, only when every coefficient is a multiple of k.
+    bool divide_exact(T k, QuasiLinearForm& result) const {
+        auto divisible = [k](const Interval<T>& iv) {
+            return iv.getLower() == iv.getUpper() && !is_inf(iv.getLower()) && iv.getLower() % k == 0;
+        };
+        if (k == 0 || !divisible(constant)) return false;
+        for (const auto& [var, coef] : coeffs) if (!divisible(coef)) return false;
+        result = QuasiLinearForm(Interval<T>(constant.getLower() / k, constant.getLower() / k));
+        for (const auto& [var, coef] : coeffs) result.coeffs.emplace(var, Interval<T>(coef.getLower() / k, coef.getLower() / k));
+        return true;
+    }
+
+    Interval<T> evaluate(const IntervalStore<T>& store) const {
+        Interval<T> result = constant;
+        for (const auto& [var, coef] : coeffs) result = add(result, mul(coef, store.get_interval(var)));
+        return result;
+    }
+};
+
+#endif
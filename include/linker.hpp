@@ -0,0 +1,154 @@
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "abstract_interpeter.hpp"
+#include "preprocessor.hpp"
+#include "report.hpp"
+#include "summary_database.hpp"
+
+struct TranslationUnit {
+    std::string path;
+    uint64_t source_hash;
+    ASTNode ast;
+    std::set<std::string> globals;      // the variables the unit declares at the top level
+    bool has_body = false;
+};
+
+// Analysis of a program made of several translation units. Their global
+// variables are linked by name, and the bodies run one after the other in the
+// order of the units, each one starting from the exit state of the previous.
+// The exit state of every unit is summarized on its globals, with its alarms,
+// so a unit whose source, settings and entry intervals did not change is not
+// re-analyzed.
+class Linker {
+public:
+    // Builds the locations of a unit from its entry store and solves them.
+    using Solver = std::function<void(AbstractInterpreter&, const ASTNode&, const Store&)>;
+
+private:
+    std::vector<TranslationUnit> units;
+    SummaryDatabase* database = nullptr;
+    bool affine_equalities = false;
+    std::string settings;   // the options that change the result of a unit
+    Solver solver = [](AbstractInterpreter& interpreter, const ASTNode& ast, const Store& entry) {
+        interpreter.create_top_locations(ast, &entry);
+        interpreter.eval_all();
+    };
+    size_t reused = 0;
+
+    uint64_t input_hash(const TranslationUnit& unit, const Store& store) const {
+        std::ostringstream key;
+        key << (affine_equalities ? "karr" : "intervals") << " " << settings << ";";
+        for (const auto& var : unit.globals) {
+            Interval<int64_t> iv = store.get_interval(var);
+            key << " " << var << " " << iv.getLower() << " " << iv.getUpper();
+        }
+        return content_hash(key.str());
+    }
+
+    // The linked variables with the initializers of all the units.
+    Store link_globals() const {
+        Store globals;
+        std::map<std::string, std::string> initialized;  // variable -> unit defining it
+        for (const auto& unit : units) {
+            std::string var;
+            for (const auto& node : unit.ast.children) {
+                if (node.type != NodeType::DECLARATION) continue;
+                for (const auto& child : node.children) {
+                    if (child.type == NodeType::VARIABLE) {
+                        var = std::get<std::string>(child.value);
+                        if (!globals.has_variable(var)) globals.update_interval(var, Interval<int64_t>());
+                    }
+                    else if (child.type == NodeType::INTEGER) {
+                        auto inserted = initialized.emplace(var, unit.path);
+                        if (!inserted.second)
+                            throw std::runtime_error("multiple definition of `" + var + "` in `" + inserted.first->second + "` and `" + unit.path + "`");
+                        int64_t value = std::get<int>(child.value);
+                        globals.update_interval(var, Interval<int64_t>(value, value));
+                    }
+                }
+            }
+        }
+        return globals;
+    }
+
+public:
+    void set_database(SummaryDatabase* db) { database = db; }
+    void enable_affine_equalities() { affine_equalities = true; }
+    void set_solver(const std::string& key, Solver solve) {
+        settings = key;
+        solver = std::move(solve);
+    }
+
+    // A unit parsed by AbstractInterpreterParser; the parser returns the node
+    // itself instead of a program root when there is a single top-level node.
+    void add_unit(const std::string& path, uint64_t source_hash, const ASTNode& ast) {
+        TranslationUnit unit{path, source_hash, ast, {}, false};
+        if (ast.type == NodeType::DECLARATION || ast.type == NodeType::ARRAY_DECL || ast.type == NodeType::SEQUENCE) {
+            unit.ast = ASTNode();
+            unit.ast.children.push_back(ast);
+        }
+        for (const auto& node : unit.ast.children) {
+            if (node.type == NodeType::SEQUENCE) unit.has_body = true;
+            else if (node.type == NodeType::DECLARATION) {
+                for (const auto& child : node.children)
+                    if (child.type == NodeType::VARIABLE) unit.globals.insert(std::get<std::string>(child.value));
+            }
+        }
+        units.push_back(unit);
+    }
+
+    size_t get_reused() const { return reused; }
+
+    Store analyze() {
+        Store state = link_globals();
+        for (const auto& unit : units) {
+            if (!unit.has_body) continue;
+            uint64_t input = input_hash(unit, state);
+            std::optional<UnitSummary> summary;
+            if (database != nullptr) summary = database->lookup(unit.path, unit.source_hash, input);
+
+            AbstractInterpreter interpreter;
+            if (summary) {
+                report_out() << "Unit `" << unit.path << "` unchanged, reusing its summary." << std::endl;
+                for (const auto& alarm : summary->alarms) report_err() << alarm << std::endl;
+                reused++;
+            }
+            else {
+                report_out() << "Analyzing unit `" << unit.path << "`..." << std::endl;
+                // Relations are not carried across units: the unit only sees
+                // the intervals of its globals, so that its summary depends on
+                // them alone.
+                Store entry;
+                if (affine_equalities) {
+                    entry.enable_affine_equalities();
+                    interpreter.enable_affine_equalities();
+                }
+                for (const auto& var : unit.globals) entry.update_interval(var, state.get_interval(var));
+                solver(interpreter, unit.ast, entry);
+                summary = UnitSummary{unit.source_hash, input, {}, interpreter.check_bounds()};
+                for (const auto& var : unit.globals) {
+                    Interval<int64_t> iv = interpreter.final_store().get_interval(var);
+                    summary->exit[var] = {iv.getLower(), iv.getUpper()};
+                }
+                if (database != nullptr) database->record(unit.path, *summary);
+            }
+            for (const auto& [var, bound] : summary->exit) state.update_interval(var, Interval<int64_t>(bound.first, bound.second));
+            interpreter.check_assertions(unit.ast, state);
+        }
+        return state;
+    }
+};
+
+#endif
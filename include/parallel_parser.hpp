@@ -0,0 +1,281 @@
+#ifndef PARALLEL_PARSER_HPP
+#define PARALLEL_PARSER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ast.hpp"
+#include "parser.hpp"
+#include "report.hpp"
+
+// Pre-scan of a source for its top-level statements, without parsing it: the
+// braces and parentheses are balanced, the comments skipped, and a statement
+// ends at a `;`, a `}` or the `*/` of a precondition at depth 0, unless an
+// `else` follows. A `//` comment between statements is a statement of the
+// grammar too, one that builds no node, so the scan reports where they are.
+class StatementScanner {
+private:
+    std::string_view src;
+
+    static bool is_identifier(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // Position after the whitespace and the `//` comments from `pos`.
+    size_t skip_blank(size_t pos, size_t end, std::vector<size_t>* comments = nullptr) const {
+        while (pos < end) {
+            if (std::isspace(static_cast<unsigned char>(src[pos]))) pos++;
+            else if (src.compare(pos, 2, "//") == 0) {
+                if (comments) comments->push_back(pos);
+                while (pos < end && src[pos] != '\n') pos++;
+            }
+            else break;
+        }
+        return pos;
+    }
+
+    bool keyword_at(size_t pos, size_t end, const char* keyword) const {
+        size_t length = std::strlen(keyword);
+        return pos + length <= end && src.compare(pos, length, keyword) == 0
+            && (pos + length == end || !is_identifier(src[pos + length]))
+            && (pos == 0 || !is_identifier(src[pos - 1]));
+    }
+
+public:
+    explicit StatementScanner(std::string_view src) : src(src) {}
+
+    // The end of the statement starting at `start`, nullopt if it does not
+    // end before `end` or a comment splits it at depth 0 (`if (c) // ...`
+    // takes the comment as its body).
+    std::optional<size_t> statement_end(size_t start, size_t end) const {
+        int depth = 0;
+        for (size_t pos = start; pos < end;) {
+            char c = src[pos];
+            bool boundary = false;
+            if (src.compare(pos, 2, "//") == 0) {
+                if (depth == 0) return std::nullopt;
+                while (pos < end && src[pos] != '\n') pos++;
+                continue;
+            }
+            if (src.compare(pos, 2, "/*") == 0) {
+                size_t close = src.find("*/", pos + 2);
+                if (close == std::string::npos || close + 2 > end) return std::nullopt;
+                pos = close + 2;
+                boundary = depth == 0;
+            }
+            else {
+                pos++;
+                if (c == '{' || c == '(') depth++;
+                else if (c == '}' || c == ')') {
+                    if (--depth < 0) return std::nullopt;
+                    boundary = depth == 0 && c == '}';
+                }
+                else if (c == ';') boundary = depth == 0;
+            }
+            if (!boundary) continue;
+            size_t next = skip_blank(pos, end);
+            if (!keyword_at(next, end, "else")) return pos;
+            if (src.substr(pos, next - pos).find("//") != std::string::npos) return std::nullopt;
+        }
+        return std::nullopt;
+    }
+
+    // Position of the next statement from `pos`, the top-level `//` comments
+    // on the way added to `comments`.
+    size_t next_statement(size_t pos, size_t end, std::vector<size_t>& comments) const {
+        return skip_blank(pos, end, &comments);
+    }
+
+    // The [begin, end) of every top-level statement of [begin, end), and in
+    // `comments` the positions of the top-level `//` comments. nullopt if a
+    // statement does not end (see statement_end) before `end`.
+    std::optional<std::vector<std::pair<size_t, size_t>>> statements(size_t begin, size_t end, std::vector<size_t>& comments) const {
+        std::vector<std::pair<size_t, size_t>> result;
+        for (size_t start = next_statement(begin, end, comments); start < end;) {
+            auto stop = statement_end(start, end);
+            if (!stop) return std::nullopt;
+            result.emplace_back(start, *stop);
+            start = next_statement(*stop, end, comments);
+        }
+        return result;
+    }
+
+    // The nodes of the `count` statements of a chunk of `items` statements
+    // of the grammar, its comments included: the parser returns the node
+    // itself for a single one, a node holding the others otherwise.
+    static bool collect(const ASTNode& chunk, size_t count, size_t items, std::vector<ASTNode>& nodes) {
+        if (items == 1) {
+            nodes.push_back(chunk);
+            return true;
+        }
+        if (chunk.children.size() != count) return false;
+        nodes.insert(nodes.end(), chunk.children.begin(), chunk.children.end());
+        return true;
+    }
+
+    // How many of the sorted `comments` are within [begin, end).
+    static size_t comments_in(const std::vector<size_t>& comments, size_t begin, size_t end) {
+        return std::lower_bound(comments.begin(), comments.end(), end) - std::lower_bound(comments.begin(), comments.end(), begin);
+    }
+
+    // The position of `void main` at depth 0 and the position after the `{`
+    // of its body, the source being scanned no further; nullopt if there is
+    // none.
+    std::optional<std::pair<size_t, size_t>> find_main_start() const {
+        int depth = 0;
+        size_t main = std::string::npos;
+        for (size_t pos = 0; pos < src.size();) {
+            if (src.compare(pos, 2, "//") == 0) {
+                while (pos < src.size() && src[pos] != '\n') pos++;
+                continue;
+            }
+            if (src.compare(pos, 2, "/*") == 0) {
+                size_t close = src.find("*/", pos + 2);
+                if (close == std::string::npos) return std::nullopt;
+                pos = close + 2;
+                continue;
+            }
+            // The grammar spells it `void main` exactly.
+            if (depth == 0 && main == std::string::npos && src.compare(pos, 9, "void main") == 0 && keyword_at(pos, src.size(), "void")) main = pos;
+            char c = src[pos++];
+            if (c == '{' || c == '(') {
+                if (c == '{' && depth == 0 && main != std::string::npos) return std::make_pair(main, pos);
+                depth++;
+            }
+            else if ((c == '}' || c == ')') && --depth < 0) return std::nullopt;
+        }
+        return std::nullopt;
+    }
+
+    // The position of `void main` at depth 0 and the [begin, end) of its body
+    // between the braces, nullopt if there is none.
+    std::optional<std::pair<size_t, std::pair<size_t, size_t>>> find_main() const {
+        auto start = find_main_start();
+        if (!start) return std::nullopt;
+        int depth = 1;
+        for (size_t pos = start->second; pos < src.size();) {
+            if (src.compare(pos, 2, "//") == 0) {
+                while (pos < src.size() && src[pos] != '\n') pos++;
+                continue;
+            }
+            if (src.compare(pos, 2, "/*") == 0) {
+                size_t close = src.find("*/", pos + 2);
+                if (close == std::string::npos) return std::nullopt;
+                pos = close + 2;
+                continue;
+            }
+            char c = src[pos++];
+            if (c == '{' || c == '(') depth++;
+            else if ((c == '}' || c == ')') && --depth == 0)
+                return c == '}' ? std::make_optional(std::make_pair(start->first, std::make_pair(start->second, pos - 1))) : std::nullopt;
+        }
+        return std::nullopt;
+    }
+};
+
+// Parsing of a large program on several threads. The body of `main` is split
+// at its top-level statements (StatementScanner), consecutive statements are
+// grouped into chunks of similar sizes, and every chunk is parsed by the
+// parser of one thread; the statements are then stitched back in order into
+// the same tree a single parser builds. A program without `main`, or whose
+// pre-scan or chunks do not parse as expected, is parsed on one thread, so the
+// errors are reported on the whole source.
+class ParallelParser {
+private:
+    unsigned threads;
+    std::vector<std::unique_ptr<AbstractInterpreterParser>> parsers;
+
+public:
+    // Smaller sources are not worth the pre-scan and the threads.
+    static constexpr size_t min_parallel_size = 1 << 20;
+
+    explicit ParallelParser(unsigned threads) : threads(std::max(1u, threads)) {
+        // Every thread needs its own parser: the actions capture it.
+        for (unsigned t = 0; t < this->threads; ++t) parsers.push_back(std::make_unique<AbstractInterpreterParser>());
+    }
+
+    ASTNode parse(const std::string& input) {
+        if (threads > 1 && input.size() >= min_parallel_size) {
+            if (auto ast = parse_parallel(input)) {
+                report_out() << "Parsing succeeded!" << std::endl;
+                return *ast;
+            }
+        }
+        return parsers[0]->parse(input);
+    }
+
+    // nullopt when the pre-scan or a chunk fails.
+    std::optional<ASTNode> parse_parallel(const std::string& input) {
+        StatementScanner scanner(input);
+        auto main = scanner.find_main();
+        if (!main) return std::nullopt;
+        auto [main_begin, body] = *main;
+        std::vector<size_t> global_comments, comments;
+        auto globals = scanner.statements(0, main_begin, global_comments);
+        auto statements = scanner.statements(body.first, body.second, comments);
+        if (!globals || !statements || statements->size() < 2) return std::nullopt;
+        if (input.find_first_not_of(" \t\r\n", body.second + 1) != std::string::npos) return std::nullopt;
+
+        // Chunks of consecutive statements, [first, last) in `statements`:
+        // a few per thread, so that a slow chunk does not hold the others.
+        size_t target = std::max<size_t>(1, (body.second - body.first) / (threads * 4));
+        std::vector<std::pair<size_t, size_t>> chunks;
+        for (size_t first = 0; first < statements->size();) {
+            size_t last = first + 1;
+            while (last < statements->size() && (*statements)[last].second - (*statements)[first].first <= target) last++;
+            chunks.emplace_back(first, last);
+            first = last;
+        }
+
+        // Task 0 is the globals, task k the chunk k - 1.
+        std::vector<ASTNode> results(chunks.size() + 1);
+        std::vector<char> parsed(chunks.size() + 1, 0);
+        std::atomic<size_t> next{0};
+        auto work = [&](unsigned t) {
+            // A failed chunk is parsed again with the whole source, which
+            // reports the errors: the ones of the chunks are dropped.
+            ReportCapture discarded;
+            for (size_t k = next++; k < results.size(); k = next++) {
+                if (k == 0) {
+                    if (globals->empty()) parsed[0] = 1;
+                    else parsed[0] = parsers[t]->try_parse(input.substr(0, main_begin), results[0]);
+                    continue;
+                }
+                auto [first, last] = chunks[k - 1];
+                size_t begin = (*statements)[first].first, end = (*statements)[last - 1].second;
+                parsed[k] = parsers[t]->try_parse(input.substr(begin, end - begin), results[k]);
+                if (parsed[k]) shift_offsets(results[k], begin);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work, t);
+        work(0);
+        for (auto& worker : workers) worker.join();
+
+        // As Program and Block build it: `main` alone is the root, otherwise
+        // the root holds the globals and `main`, a SEQUENCE of its statements.
+        ASTNode root;
+        size_t global_items = globals->size() + global_comments.size();
+        if (!parsed[0] || (!globals->empty() && !StatementScanner::collect(results[0], globals->size(), global_items, root.children))) return std::nullopt;
+        ASTNode body_node(NodeType::SEQUENCE, std::string(";"));
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            auto [first, last] = chunks[k];
+            size_t items = last - first + StatementScanner::comments_in(comments, (*statements)[first].first, (*statements)[last - 1].second);
+            if (!parsed[k + 1] || !StatementScanner::collect(results[k + 1], last - first, items, body_node.children)) return std::nullopt;
+        }
+        if (global_items == 0) return body_node;
+        root.children.push_back(std::move(body_node));
+        return root;
+    }
+};
+
+#endif
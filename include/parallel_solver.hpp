@@ -0,0 +1,262 @@
+#ifndef PARALLEL_SOLVER_HPP
+#define PARALLEL_SOLVER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "abstract_interpeter.hpp"
+#include "report.hpp"
+#include "snapshot.hpp"
+
+// Asynchronous chaotic iteration: worker threads take locations from a shared
+// work queue and evaluate them against the last published stores of their
+// inputs. A location whose store changed publishes the new version and puts
+// its dependents back in the queue. The iteration is sound for the monotone
+// transfer functions with widening at the loop heads, in any order; the
+// fixpoint is reached when the queue is empty and no worker is busy.
+//
+// The evaluation starts from the entry of the program, a location running once
+// all its predecessors ran (as the sequential sweep does), so that the stores
+// grow from the entry instead of slowly shrinking from top.
+//
+// A location is evaluated by one worker at a time, and only that worker
+// writes its store and its published versions; the readers pin published
+// versions without waiting for it. The evaluation order, hence the iteration
+// count and (because of the widening) possibly the precision, depends on the
+// scheduling: the modes whose output is reproducible (--deterministic,
+// --batch) or saved (--watch, --results, --summaries) refuse it.
+class AsyncSolver {
+private:
+    std::vector<std::shared_ptr<location>>& locations;
+    unsigned threads;
+    LocationGraph graph;
+    std::vector<std::unique_ptr<SnapshotPublisher<Store>>> published;
+    std::vector<std::atomic<uint64_t>> versions;
+    // Versions of the inputs at the last evaluation of every location.
+    std::vector<std::vector<uint64_t>> seen;
+    std::vector<std::unique_ptr<std::mutex>> evaluating;
+    std::vector<std::atomic<bool>> queued;
+    std::vector<std::atomic<bool>> reached;     // evaluated at least once
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<size_t> queue;
+    size_t outstanding = 0;    // queued or being evaluated, under queue_mutex
+    std::atomic<size_t> evaluations{0};
+
+    void enqueue(size_t i) {
+        if (queued[i].exchange(true)) return;
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(i);
+        outstanding++;
+        queue_changed.notify_one();
+    }
+
+    void evaluate(size_t i) {
+        std::lock_guard<std::mutex> lock(*evaluating[i]);
+        // The versions are read before pinning the stores, so the store pinned
+        // is never older than the version recorded: a later change of an
+        // input always gets the location evaluated again.
+        std::vector<typename SnapshotPublisher<Store>::ReadGuard> guards;
+        std::vector<size_t> pinned;
+        std::vector<const Store*> inputs;
+        std::vector<uint64_t> input_versions;
+        for (size_t j : graph.inputs[i]) {
+            bool back_edge = j >= i;
+            if (!reached[j]) {
+                // A loop body not reached yet joins nothing at its head.
+                if (!back_edge || inputs.empty()) return;
+                input_versions.push_back(0);
+                inputs.push_back(inputs.front());
+                continue;
+            }
+            input_versions.push_back(versions[j].load());
+            // An input read twice (an if without else) is pinned once.
+            size_t p = std::find(pinned.begin(), pinned.end(), j) - pinned.begin();
+            if (p == pinned.size()) {
+                pinned.push_back(j);
+                guards.push_back(published[j]->read());
+            }
+            inputs.push_back(guards[p].get());
+        }
+        bool first = !reached[i];
+        if (!first && input_versions == seen[i]) return;
+        seen[i] = input_versions;
+        evaluations++;
+        Store new_store = locations[i]->output(inputs);
+        if (!first && new_store == locations[i]->store) return;
+        locations[i]->store = std::move(new_store);
+        published[i]->publish(std::make_unique<Store>(locations[i]->store));
+        versions[i]++;
+        reached[i] = true;
+        for (size_t k : graph.dependents[i]) enqueue(k);
+    }
+
+    void work() {
+        // The messages of the transfer functions interleave arbitrarily
+        // between the workers, they are dropped.
+        ReportCapture discarded;
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_changed.wait(lock, [this] { return !queue.empty() || outstanding == 0; });
+                if (queue.empty()) return;
+                i = queue.front();
+                queue.pop_front();
+            }
+            // Cleared before the evaluation: an input changing meanwhile
+            // queues the location again.
+            queued[i] = false;
+            evaluate(i);
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (--outstanding == 0) queue_changed.notify_all();
+        }
+    }
+
+public:
+    AsyncSolver(std::vector<std::shared_ptr<location>>& locations, unsigned threads)
+        : locations(locations), threads(std::max(1u, threads)), graph(locations), versions(locations.size()), seen(locations.size()), queued(locations.size()), reached(locations.size()) {
+        for (const auto& loc : locations) {
+            published.push_back(std::make_unique<SnapshotPublisher<Store>>(this->threads));
+            published.back()->publish(std::make_unique<Store>(loc->store));
+            evaluating.push_back(std::make_unique<std::mutex>());
+        }
+    }
+
+    // Returns the number of evaluations until the fixpoint.
+    size_t run() {
+        for (size_t i = 0; i < locations.size(); ++i)
+            if (graph.inputs[i].empty()) enqueue(i);
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(&AsyncSolver::work, this);
+        work();
+        for (auto& worker : workers) worker.join();
+        return evaluations;
+    }
+};
+
+// Barrier reused by the threads of a sweep, all of them wait for the last one.
+class SweepBarrier {
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    size_t count;
+    size_t waiting = 0;
+    size_t generation = 0;
+
+public:
+    explicit SweepBarrier(size_t count) : count(count) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t current = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            generation++;
+            released.notify_all();
+        }
+        else released.wait(lock, [&] { return generation != current; });
+    }
+};
+
+// Bulk-synchronous Jacobi iteration: every sweep computes all the locations in
+// parallel from the stores of the previous sweep, so the threads never read a
+// store being written. The stores of the previous sweep are a second buffer,
+// `previous`; the locations write their own store, which is copied into the
+// buffer between two sweeps when it changed. The fixpoint is detected by a
+// reduction of the per-thread change counts.
+//
+// A sweep only propagates the stores by one location, so Jacobi needs more
+// sweeps than the sequential solver needs iterations, but every sweep is
+// embarrassingly parallel: it pays off on wide programs. The result does not
+// depend on the number of threads.
+class JacobiSolver {
+private:
+    std::vector<std::shared_ptr<location>>& locations;
+    unsigned threads;
+    LocationGraph graph;
+    std::vector<Store> previous;
+    std::vector<char> reached;      // evaluated in a previous sweep
+    std::vector<char> changed;      // during the current sweep
+
+    // Locations [begin, end) of the thread `t`.
+    std::pair<size_t, size_t> chunk(unsigned t) const {
+        size_t n = locations.size();
+        return {n * t / threads, n * (t + 1) / threads};
+    }
+
+    // Same rules as AsyncSolver: a location runs once its predecessors ran,
+    // and a loop body not reached yet joins nothing at its head.
+    bool evaluate(size_t i) {
+        std::vector<const Store*> inputs;
+        for (size_t j : graph.inputs[i]) {
+            if (!reached[j]) {
+                if (j < i || inputs.empty()) return false;
+                inputs.push_back(inputs.front());
+            }
+            else inputs.push_back(&previous[j]);
+        }
+        Store new_store = locations[i]->output(inputs);
+        if (reached[i] && new_store == locations[i]->store) return false;
+        locations[i]->store = std::move(new_store);
+        return true;
+    }
+
+public:
+    JacobiSolver(std::vector<std::shared_ptr<location>>& locations, unsigned threads)
+        : locations(locations), threads(static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, locations.size())))),
+          graph(locations), reached(locations.size(), 0), changed(locations.size(), 0) {
+        for (const auto& loc : locations) previous.push_back(loc->store);
+    }
+
+    // Returns the number of sweeps until the fixpoint.
+    size_t run() {
+        SweepBarrier barrier(threads);
+        std::vector<size_t> partial(threads, 0);
+        size_t sweeps = 0;
+        bool done = false;
+
+        auto work = [&](unsigned t) {
+            ReportCapture discarded;
+            auto [begin, end] = chunk(t);
+            while (true) {
+                partial[t] = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    changed[i] = evaluate(i);
+                    partial[t] += changed[i];
+                }
+                barrier.wait();
+                // Swap of the buffers: only the stores that changed are copied.
+                for (size_t i = begin; i < end; ++i) {
+                    if (!changed[i]) continue;
+                    previous[i] = locations[i]->store;
+                    reached[i] = 1;
+                }
+                if (t == 0) {
+                    size_t total = 0;
+                    for (size_t count : partial) total += count;
+                    sweeps++;
+                    done = total == 0;
+                }
+                barrier.wait();
+                if (done) return;
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work, t);
+        work(0);
+        for (auto& worker : workers) worker.join();
+        return sweeps;
+    }
+};
+
+#endif
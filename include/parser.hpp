@@ -7,8 +7,11 @@
 #include "peglib.h"
 #include <assert.h>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 #include "ast.hpp"
+#include "report.hpp"
 
 class AbstractInterpreterParser{
     using SV = peg::SemanticValues;
@@ -16,27 +19,49 @@ class AbstractInterpreterParser{
 public:
     // ASTNode root;
 
-    ASTNode parse(const std::string& input){
-        peg::parser parser(R"(
+    // The grammar is compiled once, the same parser is reused for every input.
+    AbstractInterpreterParser(){
+        parser.load_grammar(R"(
             Program     <- Statements*
-            Statements  <- DeclareVar / Assignment / Increment / IfElse / WhileLoop / Block / PreCon / PostCon / Comment
+            Statements  <- DeclareArray / DeclareVar / Break / Continue / ArrayAssign / Assignment / Increment / IfElse / WhileLoop / Block / PreCon / PostCon / Comment
             Integer     <- < [+-]? [0-9]+ >
             Identifier  <- < [a-zA-Z_][a-zA-Z0-9_]* >
             SeqOp       <- '+' / '-'
-            PreOp       <- '*' / '/'
-            LogicOp     <- '<=' / '>=' / '==' / '!=' / '<' / '>'
+            PreOp       <- '*' / '/' / '%'
+            ShiftOp     <- '<<' / '>>'
+            BitAndOp    <- '&' !'&'
+            BitXorOp    <- '^'
+            BitOrOp     <- '|' !'|'
+            EqualityOp  <- '==' / '!='
+            RelationalOp <- '<=' / '>=' / '<' / '>'
             DeclareVar  <- 'int' Identifier ('=' Integer / ',' Identifier)* ';'
+            DeclareArray <- 'int' Identifier '[' Integer ']' ';'
             PreCon      <- '/*!npk' Identifier 'between' Integer 'and' Integer '*/'
             PostCon     <- 'assert' '(' Expression ')' ';'
             Assignment  <- Identifier '=' Expression ';'
+            ArrayAssign <- ArrayAccess '=' Expression ';'
+            ArrayAccess <- Identifier '[' Expression ']'
             Increment   <- Identifier '++' ';'
+            Break       <- 'break' ';'
+            Continue    <- 'continue' ';'
             Block       <- ('void main' '(' ')')? '{' Statements* '}'
-            IfElse      <- 'if' '(' Expression ')' (Block / Statements) ('else' (Block / Statements))?
-            WhileLoop   <- 'while' '(' Expression ')' (Block / Statements)
+            IfElse      <- 'if' '(' Condition ')' (Block / Statements) ('else' (Block / Statements))?
+            WhileLoop   <- 'while' '(' Condition ')' (Block / Statements)
+
+            Condition   <- Conjunction ('||' Conjunction)*
+            Conjunction <- Negation ('&&' Negation)*
+            Negation    <- '!' !'=' Negation / Expression &('&&' / '||' / ')') / '(' Condition ')'
 
-            Expression  <- Term ((SeqOp / LogicOp) Term)*
+            Expression  <- BitOr
+            BitOr       <- BitXor (BitOrOp BitXor)*
+            BitXor      <- BitAnd (BitXorOp BitAnd)*
+            BitAnd      <- Equality (BitAndOp Equality)*
+            Equality    <- Relational (EqualityOp Relational)*
+            Relational  <- Shift (RelationalOp Shift)*
+            Shift       <- Sum (ShiftOp Sum)*
+            Sum         <- Term (SeqOp Term)*
             Term        <- Factor (PreOp Factor)*
-            Factor      <- '-' Factor / Integer / Identifier / '(' Expression ')'
+            Factor      <- '-' Factor / Integer / ArrayAccess / Identifier / '(' Expression ')'
 
             ~Comment    <- '//' [^\n\r]* [ \n\r\t]*
             %whitespace <- [ \n\r\t]*
@@ -49,32 +74,78 @@ public:
         parser["Identifier"] = [](const SV& sv){return ASTNode(sv.token_to_string());};
         parser["SeqOp"] = [this](const SV& sv){return make_seq_op(sv);};
         parser["PreOp"] = [this](const SV& sv){return make_pre_op(sv);};
-        parser["LogicOp"] = [this](const SV& sv){return make_logic_op(sv);};
-        parser["DeclareVar"] = [this](const SV& sv){return make_decl_var(sv);};
-        parser["PreCon"] = [this](const SV& sv){return make_pre_con(sv);};
-        parser["PostCon"] = [this](const SV& sv){return make_post_con(sv);};
-        parser["Assignment"] = [this](const SV& sv){return make_assign(sv);};
-        parser["Increment"] = [this](const SV& sv){return make_increment(sv);};
+        parser["ShiftOp"] = [this](const SV& sv){return make_bit_op(sv);};
+        parser["BitAndOp"] = [this](const SV& sv){return make_bit_op(sv);};
+        parser["BitXorOp"] = [this](const SV& sv){return make_bit_op(sv);};
+        parser["BitOrOp"] = [this](const SV& sv){return make_bit_op(sv);};
+        parser["EqualityOp"] = [this](const SV& sv){return make_logic_op(sv);};
+        parser["RelationalOp"] = [this](const SV& sv){return make_logic_op(sv);};
+        parser["DeclareVar"] = [this](const SV& sv){return at_statement(make_decl_var(sv), sv);};
+        parser["DeclareArray"] = [this](const SV& sv){return at_statement(make_decl_array(sv), sv);};
+        parser["ArrayAccess"] = [this](const SV& sv){return make_array_access(sv);};
+        parser["ArrayAssign"] = [this](const SV& sv){return at_statement(make_assign(sv), sv);};
+        parser["PreCon"] = [this](const SV& sv){return at_statement(make_pre_con(sv), sv);};
+        parser["PostCon"] = [this](const SV& sv){return at_statement(make_post_con(sv), sv);};
+        parser["Assignment"] = [this](const SV& sv){return at_statement(make_assign(sv), sv);};
+        parser["Increment"] = [this](const SV& sv){return at_statement(make_increment(sv), sv);};
+        parser["Break"] = [](const SV& sv){return at_statement(ASTNode(NodeType::BREAK, std::string("break")), sv);};
+        parser["Continue"] = [](const SV& sv){return at_statement(ASTNode(NodeType::CONTINUE, std::string("continue")), sv);};
         parser["Block"] = [this](const SV& sv){return make_block(sv);};
-        parser["IfElse"] = [this](const SV& sv){return make_ifelse(sv);};
-        parser["WhileLoop"] = [this](const SV& sv){return make_whileloop(sv);};
+        parser["IfElse"] = [this](const SV& sv){return at_statement(make_ifelse(sv), sv);};
+        parser["WhileLoop"] = [this](const SV& sv){return at_statement(make_whileloop(sv), sv);};
         parser["Expression"] = [this](const SV& sv){return make_expr(sv);};
+        parser["Condition"] = [this](const SV& sv){return make_bool_op(sv, "||");};
+        parser["Conjunction"] = [this](const SV& sv){return make_bool_op(sv, "&&");};
+        parser["Negation"] = [this](const SV& sv){return make_negation(sv);};
+        parser["BitOr"] = [this](const SV& sv){return make_left_assoc(sv);};
+        parser["BitXor"] = [this](const SV& sv){return make_left_assoc(sv);};
+        parser["BitAnd"] = [this](const SV& sv){return make_left_assoc(sv);};
+        parser["Equality"] = [this](const SV& sv){return make_left_assoc(sv);};
+        parser["Relational"] = [this](const SV& sv){return make_left_assoc(sv);};
+        parser["Shift"] = [this](const SV& sv){return make_left_assoc(sv);};
+        parser["Sum"] = [this](const SV& sv){return make_expr(sv);};
         parser["Term"] = [this](const SV& sv){return make_term(sv);};
         parser["Factor"] = [this](const SV& sv){return make_factor(sv);};
         parser.set_logger([](size_t line, size_t col, const std::string& msg, const std::string &rule) {
-            std::cerr << line << ":" << col << ": " << msg << "\n";
+            report_err() << line << ":" << col << ": " << msg << "\n";
         });
+    }
+
+    // The actions capture `this`.
+    AbstractInterpreterParser(const AbstractInterpreterParser&) = delete;
+    AbstractInterpreterParser& operator=(const AbstractInterpreterParser&) = delete;
 
+    // Throws on a program the grammar accepts but the analysis cannot, see
+    // `invalid`.
+    ASTNode parse(const std::string& input){
         ASTNode root;
-        if (parser.parse(input.c_str(), root)){
-            std::cout << "Parsing succeeded!" << std::endl;
+        invalid.clear();
+        if (parser.parse(input.c_str(), root) && invalid.empty()){
+            report_out() << "Parsing succeeded!" << std::endl;
         }else{
-            std::cerr << "Parsing failed!" << std::endl;
+            report_err() << "Parsing failed!" << std::endl;
         }   
+        if (!invalid.empty()) throw std::runtime_error(invalid);
         return root;
     }
 
+    // Without the success message, for the parsers of ParallelParser.
+    bool try_parse(const std::string& input, ASTNode& root){
+        invalid.clear();
+        return parser.parse(input.c_str(), root) && invalid.empty();
+    }
+
 private:
+    peg::parser parser;
+    // `line:col: message` of the first invalid declaration.
+    std::string invalid;
+
+    // Records where the statement starts in the parsed source.
+    static ASTNode at_statement(ASTNode node, const SV& sv){
+        node.offset = static_cast<size_t>(sv.sv().data() - sv.ss);
+        return node;
+    }
+
     ASTNode make_program(const SV& sv){
         if (sv.size() == 1){
             return std::any_cast<ASTNode>(sv[0]);
@@ -104,6 +175,26 @@ private:
         return decl_node;
     }
 
+    // `int a[N];`, N > 0.
+    ASTNode make_decl_array(const SV& sv){
+        ASTNode decl_node(NodeType::ARRAY_DECL, std::get<std::string>(std::any_cast<ASTNode>(sv[0]).value));
+        decl_node.children.push_back(std::any_cast<ASTNode>(sv[1]));
+        int size = std::get<int>(decl_node.children[0].value);
+        if (size <= 0 && invalid.empty()) {
+            auto [line, col] = sv.line_info();
+            invalid = std::to_string(line) + ":" + std::to_string(col) + ": the size of the array `" + std::get<std::string>(decl_node.value)
+                    + "` must be positive, not " + std::to_string(size);
+        }
+        return decl_node;
+    }
+
+    // `a[index]`, read or written.
+    ASTNode make_array_access(const SV& sv){
+        ASTNode access_node(NodeType::ARRAY_ACCESS, std::get<std::string>(std::any_cast<ASTNode>(sv[0]).value));
+        access_node.children.push_back(std::any_cast<ASTNode>(sv[1]));
+        return access_node;
+    }
+
     ASTNode make_pre_con(const SV& sv){
         ASTNode pre_con_node(NodeType::PRE_CON, std::string("PreCon"));
         ASTNode var(std::any_cast<ASTNode>(sv[0]));
@@ -125,9 +216,11 @@ private:
         return pre_con_node;
     }
 
+    // An assertion that is not a comparison, `assert(x & 1)`, is `x & 1 != 0`.
     ASTNode make_post_con(const SV& sv){
         ASTNode post_con_node(NodeType::POST_CON, std::string("PostCon"));
         ASTNode expr(std::any_cast<ASTNode>(sv[0]));
+        if (expr.type != NodeType::LOGIC_OP) expr = ASTNode(LogicOp::NEQ, expr, ASTNode(0));
         post_con_node.children.push_back(expr);
         return post_con_node;
     }
@@ -145,9 +238,34 @@ private:
         std::string op = sv.token_to_string();
         if (op == "*") op_node.value = BinOp::MUL;
         else if (op == "/") op_node.value = BinOp::DIV;
+        else if (op == "%") op_node.value = BinOp::MOD;
         return op_node;
     }
 
+    ASTNode make_bit_op(const SV& sv){
+        ASTNode op_node(NodeType::ARITHM_OP);
+        std::string op = sv.token_to_string();
+        if (op == "&") op_node.value = BinOp::AND;
+        else if (op == "|") op_node.value = BinOp::OR;
+        else if (op == "^") op_node.value = BinOp::XOR;
+        else if (op == "<<") op_node.value = BinOp::SHL;
+        else if (op == ">>") op_node.value = BinOp::SHR;
+        return op_node;
+    }
+
+    // operand (op operand)* folded to the left: a & b & c is (a & b) & c,
+    // and a < b < c is (a < b) < c, as in C.
+    ASTNode make_left_assoc(const SV& sv){
+        ASTNode expr = std::any_cast<ASTNode>(sv[0]);
+        for (size_t i = 1; i + 1 < sv.size(); i += 2){
+            ASTNode op = std::any_cast<ASTNode>(sv[i]);
+            ASTNode right = std::any_cast<ASTNode>(sv[i+1]);
+            if (op.type == NodeType::LOGIC_OP) expr = ASTNode(std::get<LogicOp>(op.value), expr, right);
+            else expr = ASTNode(std::get<BinOp>(op.value), expr, right);
+        }
+        return expr;
+    }
+
     ASTNode make_logic_op(const SV& sv){
         ASTNode lop_node(NodeType::LOGIC_OP);
         std::string lop = sv.token_to_string();
@@ -160,6 +278,31 @@ private:
         return lop_node;
     }
 
+    // `a && b && c` as ((a && b) && c), the operands left to right.
+    ASTNode make_bool_op(const SV& sv, const std::string& op){
+        ASTNode expr = std::any_cast<ASTNode>(sv[0]);
+        for (size_t i = 1; i < sv.size(); ++i){
+            ASTNode bool_node(NodeType::BOOL_OP, op);
+            bool_node.children.push_back(expr);
+            bool_node.children.push_back(std::any_cast<ASTNode>(sv[i]));
+            expr = bool_node;
+        }
+        return expr;
+    }
+
+    // A guard operand that is not a comparison, `x`, is `x != 0`.
+    ASTNode make_negation(const SV& sv){
+        ASTNode operand = std::any_cast<ASTNode>(sv[0]);
+        if (sv.choice() == 0){
+            ASTNode not_node(NodeType::BOOL_OP, std::string("!"));
+            not_node.children.push_back(operand);
+            return not_node;
+        }
+        if (operand.type != NodeType::LOGIC_OP && operand.type != NodeType::BOOL_OP)
+            return ASTNode(LogicOp::NEQ, operand, ASTNode(0));
+        return operand;
+    }
+
     ASTNode make_expr(const SV& sv){
         if (sv.size() == 1){
             return std::any_cast<ASTNode>(sv[0]);
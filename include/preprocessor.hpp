@@ -0,0 +1,610 @@
+#ifndef PREPROCESSOR_HPP
+#define PREPROCESSOR_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "report.hpp"
+
+struct PPToken {
+    enum Kind {IDENTIFIER, NUMBER, LITERAL, PUNCT};
+    Kind kind;
+    std::string text;
+    bool space_before = false;
+};
+
+// One logical line (continuations joined) of a source file.
+struct PPLine {
+    std::vector<PPToken> tokens;
+    size_t number = 0;
+    bool is_directive() const { return !tokens.empty() && tokens[0].text == "#"; }
+};
+
+// Token stream of a file. It does not depend on the macros defined when the
+// file is included, so it can be shared by every inclusion of a header.
+struct TokenizedFile {
+    std::vector<PPLine> lines;
+    std::string guard;          // include guard macro, if the whole file is wrapped in one
+    bool pragma_once = false;
+};
+
+uint64_t content_hash(const std::string& content) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : content) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+// Splits a source into lines of tokens. Comments are dropped, except the
+// `/*!npk ... */` annotations of the analyzer which are kept as tokens.
+std::shared_ptr<TokenizedFile> tokenize(const std::string& src, const std::string& path) {
+    auto file = std::make_shared<TokenizedFile>();
+    PPLine line;
+    line.number = 1;
+    size_t number = 1;
+    bool space = false;
+    bool annotation = false;
+    auto flush = [&]() {
+        if (!line.tokens.empty()) file->lines.push_back(line);
+        line = PPLine();
+        line.number = number;
+        space = false;
+    };
+    auto push = [&](PPToken::Kind kind, const std::string& text) {
+        line.tokens.push_back(PPToken{kind, text, space});
+        space = false;
+    };
+    size_t i = 0, n = src.size();
+    while (i < n) {
+        char c = src[i];
+        if (c == '\\' && i + 1 < n && src[i + 1] == '\n') { i += 2; number++; space = true; continue; }
+        if (c == '\n') { i++; number++; flush(); continue; }
+        if (std::isspace(static_cast<unsigned char>(c))) { i++; space = true; continue; }
+        if (src.compare(i, 6, "/*!npk") == 0) { push(PPToken::PUNCT, "/*!npk"); i += 6; annotation = true; continue; }
+        if (annotation && src.compare(i, 2, "*/") == 0) { push(PPToken::PUNCT, "*/"); i += 2; annotation = false; continue; }
+        if (src.compare(i, 2, "//") == 0) { while (i < n && src[i] != '\n') i++; continue; }
+        if (src.compare(i, 2, "/*") == 0) {
+            size_t end = src.find("*/", i + 2);
+            if (end == std::string::npos) throw std::runtime_error(path + ":" + std::to_string(number) + ": unterminated comment");
+            for (size_t k = i; k < end; ++k) if (src[k] == '\n') number++;
+            i = end + 2;
+            space = true;
+            continue;
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = i;
+            while (i < n && (std::isalnum(static_cast<unsigned char>(src[i])) || src[i] == '_')) i++;
+            push(PPToken::IDENTIFIER, src.substr(start, i - start));
+            continue;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            size_t start = i;
+            while (i < n && (std::isalnum(static_cast<unsigned char>(src[i])) || src[i] == '_')) i++;
+            push(PPToken::NUMBER, src.substr(start, i - start));
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            size_t start = i++;
+            while (i < n && src[i] != c && src[i] != '\n') i += src[i] == '\\' ? 2 : 1;
+            i = std::min(i + 1, n);
+            push(PPToken::LITERAL, src.substr(start, i - start));
+            continue;
+        }
+        if (src.compare(i, 2, "##") == 0) { push(PPToken::PUNCT, "##"); i += 2; continue; }
+        push(PPToken::PUNCT, std::string(1, c));
+        i++;
+    }
+    flush();
+
+    // Include guard: #ifndef X / #define X ... #endif around the whole file.
+    const auto& lines = file->lines;
+    if (lines.size() >= 3 && lines[0].is_directive() && lines[0].tokens.size() == 3 && lines[0].tokens[1].text == "ifndef" &&
+        lines[1].is_directive() && lines[1].tokens.size() >= 3 && lines[1].tokens[1].text == "define" &&
+        lines[1].tokens[2].text == lines[0].tokens[2].text &&
+        lines.back().is_directive() && lines.back().tokens.size() >= 2 && lines.back().tokens[1].text == "endif") {
+        int depth = 0;
+        bool whole = true;
+        for (size_t k = 0; k < lines.size() && whole; ++k) {
+            if (!lines[k].is_directive() || lines[k].tokens.size() < 2) continue;
+            const std::string& d = lines[k].tokens[1].text;
+            if (d == "if" || d == "ifdef" || d == "ifndef") depth++;
+            else if (d == "endif" && --depth == 0 && k + 1 != lines.size()) whole = false;
+        }
+        if (whole) file->guard = lines[0].tokens[2].text;
+    }
+    for (const auto& l : lines)
+        if (l.is_directive() && l.tokens.size() >= 3 && l.tokens[1].text == "pragma" && l.tokens[2].text == "once")
+            file->pragma_once = true;
+    return file;
+}
+
+// Token streams of the headers, by path and content hash. One cache can be
+// shared by all the files of a batch (and by several threads).
+class HeaderCache {
+private:
+    struct Entry {
+        uint64_t hash;
+        std::shared_ptr<const TokenizedFile> file;
+    };
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    size_t hits = 0;
+    size_t misses = 0;
+
+public:
+    std::shared_ptr<const TokenizedFile> get(const std::string& path, const std::string& content) {
+        uint64_t hash = content_hash(content);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(path);
+            if (it != entries.end() && it->second.hash == hash) { hits++; return it->second.file; }
+            misses++;
+        }
+        std::shared_ptr<const TokenizedFile> file = tokenize(content, path);
+        std::lock_guard<std::mutex> lock(mutex);
+        entries[path] = Entry{hash, file};
+        return file;
+    }
+
+    size_t get_hits() const { return hits; }
+    size_t get_misses() const { return misses; }
+};
+// Where the lines of a preprocessed text come from: output line k starts at
+// starts[k] and is line lines[k].second of files[lines[k].first].
+struct SourceMap {
+    std::vector<std::string> files;
+    std::vector<size_t> starts;
+    std::vector<std::pair<uint32_t, uint32_t>> lines;
+
+    // The file and line of an offset of the preprocessed text.
+    std::pair<uint32_t, uint32_t> locate(size_t offset) const {
+        size_t k = std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin();
+        return k == 0 ? std::make_pair(0u, 0u) : lines[k - 1];
+    }
+};
+
+// C preprocessor for the analyzed programs: #include (with include paths,
+// include guards and #pragma once), object-like and function-like #define,
+// #undef, and the conditionals #if/#ifdef/#ifndef/#elif/#else/#endif.
+class Preprocessor {
+private:
+    struct Macro {
+        bool function_like = false;
+        std::vector<std::string> params;
+        std::vector<PPToken> body;
+    };
+
+    std::vector<std::string> include_paths;
+    HeaderCache& cache;
+    std::map<std::string, Macro> macros;
+    std::set<std::string> once;
+    std::map<std::string, std::string> guards;  // include guard of the files seen so far
+    std::vector<std::string> stack;     // files being included
+    SourceMap map;
+    static constexpr size_t max_depth = 200;
+
+    [[noreturn]] void error(const std::string& path, size_t line, const std::string& msg) const {
+        throw std::runtime_error(path + ":" + std::to_string(line) + ": " + msg);
+    }
+
+    static std::string directory_of(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    }
+
+    static bool read_file(const std::string& path, std::string& content) {
+        std::ifstream f(path);
+        if (!f.is_open()) return false;
+        std::ostringstream buffer;
+        buffer << f.rdbuf();
+        content = buffer.str();
+        return true;
+    }
+
+    // Expands the macros of tokens, a macro is not expanded again inside its own expansion.
+    std::vector<PPToken> expand(const std::vector<PPToken>& tokens, const std::set<std::string>& disabled) const {
+        std::vector<PPToken> out;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            const PPToken& t = tokens[i];
+            auto it = t.kind == PPToken::IDENTIFIER && !disabled.count(t.text) ? macros.find(t.text) : macros.end();
+            if (it == macros.end()) { out.push_back(t); continue; }
+            const Macro& m = it->second;
+            std::set<std::string> inner = disabled;
+            inner.insert(t.text);
+            std::vector<PPToken> replaced;
+            if (!m.function_like) {
+                replaced = m.body;
+            }
+            else {
+                if (i + 1 >= tokens.size() || tokens[i + 1].text != "(") { out.push_back(t); continue; }
+                std::vector<std::vector<PPToken>> args(1);
+                size_t j = i + 2;
+                for (int depth = 0; j < tokens.size(); ++j) {
+                    const std::string& s = tokens[j].text;
+                    if (s == ")" && depth == 0) break;
+                    if (s == "(") depth++;
+                    if (s == ")") depth--;
+                    if (s == "," && depth == 0) args.emplace_back();
+                    else args.back().push_back(tokens[j]);
+                }
+                if (j >= tokens.size()) { out.push_back(t); continue; }
+                if (m.params.empty() && args.size() == 1 && args[0].empty()) args.clear();
+                if (args.size() != m.params.size()) throw std::runtime_error("macro `" + t.text + "` expects " + std::to_string(m.params.size()) + " arguments");
+                for (size_t k = 0; k < m.body.size(); ++k) {
+                    const PPToken& b = m.body[k];
+                    size_t p = 0;
+                    if (b.text == "#" && k + 1 < m.body.size()) {
+                        for (p = 0; p < m.params.size() && m.params[p] != m.body[k + 1].text; ++p);
+                        if (p < m.params.size()) {
+                            std::string text;
+                            for (const auto& a : args[p]) text += (a.space_before && !text.empty() ? " " : "") + a.text;
+                            replaced.push_back(PPToken{PPToken::LITERAL, "\"" + text + "\"", b.space_before});
+                            k++;
+                            continue;
+                        }
+                    }
+                    for (p = 0; p < m.params.size() && m.params[p] != b.text; ++p);
+                    if (b.kind != PPToken::IDENTIFIER || p == m.params.size()) { replaced.push_back(b); continue; }
+                    bool pasted = (k > 0 && m.body[k - 1].text == "##") || (k + 1 < m.body.size() && m.body[k + 1].text == "##");
+                    std::vector<PPToken> arg = pasted ? args[p] : expand(args[p], disabled);
+                    for (size_t a = 0; a < arg.size(); ++a) {
+                        PPToken tok = arg[a];
+                        if (a == 0) tok.space_before = b.space_before;
+                        replaced.push_back(tok);
+                    }
+                }
+                i = j;
+            }
+            // Token pasting.
+            std::vector<PPToken> pasted;
+            for (size_t k = 0; k < replaced.size(); ++k) {
+                if (replaced[k].text == "##" && !pasted.empty() && k + 1 < replaced.size()) {
+                    pasted.back().text += replaced[++k].text;
+                    if (std::isalpha(static_cast<unsigned char>(pasted.back().text[0])) || pasted.back().text[0] == '_')
+                        pasted.back().kind = PPToken::IDENTIFIER;
+                }
+                else pasted.push_back(replaced[k]);
+            }
+            if (!pasted.empty()) pasted[0].space_before = t.space_before;
+            for (auto& tok : expand(pasted, inner)) out.push_back(tok);
+        }
+        return out;
+    }
+
+    // Constant expression of #if / #elif, with the operators of C and their
+    // precedence. The operands short-circuit evaluation skips are parsed but
+    // not evaluated: `0 && 1 / 0` is 0.
+    class Condition {
+        const std::vector<PPToken>& toks;
+        size_t pos = 0;
+        int skipped = 0;    // > 0 inside an operand that is not evaluated
+    public:
+        explicit Condition(const std::vector<PPToken>& toks) : toks(toks) {}
+        bool accept(const std::string& s) {
+            if (pos < toks.size() && toks[pos].text == s) { pos++; return true; }
+            return false;
+        }
+        // `op` made of two tokens, e.g. `&` `&`
+        bool accept2(const std::string& a, const std::string& b) {
+            if (pos + 1 < toks.size() && toks[pos].text == a && toks[pos + 1].text == b && !toks[pos + 1].space_before) { pos += 2; return true; }
+            return false;
+        }
+        // `op` alone, not the first token of `op` `next`, e.g. `&` but not `&&`
+        bool accept_single(const std::string& op, const std::string& next) {
+            if (pos + 1 < toks.size() && toks[pos + 1].text == next && !toks[pos + 1].space_before && toks[pos].text == op) return false;
+            return accept(op);
+        }
+        void expect(const std::string& s) {
+            if (!accept(s)) throw std::runtime_error("expected `" + s + "` in #if expression");
+        }
+        // The expression, throws when tokens are left after it.
+        long long evaluate() {
+            long long v = conditional();
+            if (pos < toks.size()) throw std::runtime_error("unexpected `" + toks[pos].text + "` in #if expression");
+            return v;
+        }
+        // Wrapping arithmetic, as on unsigned values.
+        static long long wrap(unsigned long long v) { return static_cast<long long>(v); }
+        // The value of a character constant, `'c'` or an escape sequence.
+        static long long character(const std::string& text) {
+            std::string body = text.size() >= 3 && text.back() == '\'' ? text.substr(1, text.size() - 2) : "";
+            auto malformed = [&]() { return std::runtime_error("malformed character constant " + text + " in #if expression"); };
+            if (body.empty()) throw malformed();
+            if (body[0] != '\\') {
+                if (body.size() != 1) throw malformed();
+                return static_cast<unsigned char>(body[0]);
+            }
+            static const std::map<char, char> escapes = {{'n', '\n'}, {'t', '\t'}, {'r', '\r'}, {'a', '\a'}, {'b', '\b'}, {'f', '\f'},
+                                                         {'v', '\v'}, {'\\', '\\'}, {'\'', '\''}, {'"', '"'}, {'?', '?'}};
+            auto it = body.size() == 2 ? escapes.find(body[1]) : escapes.end();
+            if (it != escapes.end()) return static_cast<unsigned char>(it->second);
+            bool hex = body.size() > 2 && body[1] == 'x';
+            std::string digits = body.substr(hex ? 2 : 1);
+            if (digits.empty() || digits.size() > (hex ? 8 : 3) || digits.find_first_not_of(hex ? "0123456789abcdefABCDEF" : "01234567") != std::string::npos)
+                throw malformed();
+            return static_cast<unsigned char>(std::stoull(digits, nullptr, hex ? 16 : 8));
+        }
+        long long primary() {
+            if (pos >= toks.size()) throw std::runtime_error("incomplete #if expression");
+            if (accept("(")) { long long v = conditional(); expect(")"); return v; }
+            const PPToken& t = toks[pos++];
+            if (t.kind == PPToken::NUMBER) {
+                size_t used = 0;
+                unsigned long long v;
+                try { v = std::stoull(t.text, &used, 0); }
+                catch (const std::exception&) { throw std::runtime_error("invalid number `" + t.text + "` in #if expression"); }
+                if (t.text.find_first_not_of("uUlL", used) != std::string::npos) throw std::runtime_error("invalid number `" + t.text + "` in #if expression");
+                return wrap(v);
+            }
+            if (t.kind == PPToken::LITERAL && t.text[0] == '\'') return character(t.text);
+            if (t.kind == PPToken::IDENTIFIER) return 0;  // identifiers left after expansion are 0
+            throw std::runtime_error("unexpected `" + t.text + "` in #if expression");
+        }
+        long long unary() {
+            if (accept("!")) return !unary();
+            if (accept("-")) return wrap(0ULL - static_cast<unsigned long long>(unary()));
+            if (accept("+")) return unary();
+            if (accept("~")) return ~unary();
+            return primary();
+        }
+        long long multiplicative() {
+            long long v = unary();
+            while (true) {
+                bool product = accept("*");
+                if (!product && !accept("/") && !accept("%")) return v;
+                char op = product ? '*' : toks[pos - 1].text[0];
+                long long r = unary();
+                if (op == '*') v = wrap(static_cast<unsigned long long>(v) * static_cast<unsigned long long>(r));
+                else if (r == 0 || (r == -1 && v == std::numeric_limits<long long>::lowest())) {
+                    if (!skipped) throw std::runtime_error(std::string(op == '/' ? "division" : "remainder") + " by zero in #if expression");
+                    v = 0;
+                }
+                else v = op == '/' ? v / r : v % r;
+            }
+        }
+        long long additive() {
+            long long v = multiplicative();
+            while (true) {
+                if (accept("+")) v = wrap(static_cast<unsigned long long>(v) + static_cast<unsigned long long>(multiplicative()));
+                else if (accept("-")) v = wrap(static_cast<unsigned long long>(v) - static_cast<unsigned long long>(multiplicative()));
+                else return v;
+            }
+        }
+        long long shift() {
+            long long v = additive();
+            while (true) {
+                bool left = accept2("<", "<");
+                if (!left && !accept2(">", ">")) return v;
+                long long r = additive();
+                if (r < 0 || r > 63) {
+                    if (!skipped) throw std::runtime_error("invalid shift by " + std::to_string(r) + " in #if expression");
+                    v = 0;
+                }
+                else v = left ? wrap(static_cast<unsigned long long>(v) << r) : v >> r;
+            }
+        }
+        long long relational() {
+            long long v = shift();
+            while (true) {
+                if (accept2("<", "=")) v = v <= shift();
+                else if (accept2(">", "=")) v = v >= shift();
+                else if (accept("<")) v = v < shift();
+                else if (accept(">")) v = v > shift();
+                else return v;
+            }
+        }
+        long long equality() {
+            long long v = relational();
+            while (true) {
+                if (accept2("=", "=")) v = v == relational();
+                else if (accept2("!", "=")) v = v != relational();
+                else return v;
+            }
+        }
+        long long bit_and() {
+            long long v = equality();
+            while (accept_single("&", "&")) v &= equality();
+            return v;
+        }
+        long long bit_xor() {
+            long long v = bit_and();
+            while (accept("^")) v ^= bit_and();
+            return v;
+        }
+        long long bit_or() {
+            long long v = bit_xor();
+            while (accept_single("|", "|")) v |= bit_xor();
+            return v;
+        }
+        // The right operand, not evaluated when `skip`.
+        template <typename Operand>
+        long long operand(bool skip, Operand parse) {
+            skipped += skip;
+            long long v = (this->*parse)();
+            skipped -= skip;
+            return v;
+        }
+        long long logical_and() {
+            long long v = bit_or();
+            while (accept2("&", "&")) { long long r = operand(v == 0, &Condition::bit_or); v = v && r; }
+            return v;
+        }
+        long long logical_or() {
+            long long v = logical_and();
+            while (accept2("|", "|")) { long long r = operand(v != 0, &Condition::logical_and); v = v || r; }
+            return v;
+        }
+        long long conditional() {
+            long long v = logical_or();
+            if (!accept("?")) return v;
+            long long then = operand(v == 0, &Condition::conditional);
+            expect(":");
+            long long otherwise = operand(v != 0, &Condition::conditional);
+            return v != 0 ? then : otherwise;
+        }
+    };
+
+    bool evaluate_condition(const std::vector<PPToken>& tokens, const std::string& path, size_t line) const {
+        // `defined X` and `defined(X)` are resolved before the macro expansion.
+        std::vector<PPToken> resolved;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i].text != "defined") { resolved.push_back(tokens[i]); continue; }
+            bool paren = i + 1 < tokens.size() && tokens[i + 1].text == "(";
+            size_t name = i + (paren ? 2 : 1);
+            if (name >= tokens.size()) error(path, line, "`defined` without a macro name");
+            resolved.push_back(PPToken{PPToken::NUMBER, macros.count(tokens[name].text) ? "1" : "0", true});
+            i = name + (paren ? 1 : 0);
+        }
+        std::vector<PPToken> expanded = expand(resolved, {});
+        Condition cond(expanded);
+        try {
+            return cond.evaluate() != 0;
+        } catch (const std::runtime_error& e) {
+            error(path, line, e.what());
+        }
+    }
+
+    void define(const std::vector<PPToken>& toks, const std::string& path, size_t line) {
+        if (toks.size() < 3 || toks[2].kind != PPToken::IDENTIFIER) error(path, line, "#define without a macro name");
+        Macro m;
+        size_t i = 3;
+        if (i < toks.size() && toks[i].text == "(" && !toks[i].space_before) {
+            m.function_like = true;
+            for (i++; i < toks.size() && toks[i].text != ")"; ++i)
+                if (toks[i].text != ",") m.params.push_back(toks[i].text);
+            if (i == toks.size()) error(path, line, "unterminated macro parameter list");
+            i++;
+        }
+        m.body.assign(toks.begin() + i, toks.end());
+        if (!m.body.empty()) m.body[0].space_before = true;
+        macros[toks[2].text] = m;
+    }
+
+    void include(const std::vector<PPToken>& toks, const std::string& path, size_t line, std::string& out) {
+        std::vector<PPToken> target = toks.size() > 2 && toks[2].kind == PPToken::IDENTIFIER
+            ? expand(std::vector<PPToken>(toks.begin() + 2, toks.end()), {})
+            : std::vector<PPToken>(toks.begin() + 2, toks.end());
+        if (target.empty()) error(path, line, "#include without a file name");
+        bool system = target[0].text == "<";
+        std::string name;
+        if (system) for (size_t i = 1; i < target.size() && target[i].text != ">"; ++i) name += target[i].text;
+        else if (target[0].kind == PPToken::LITERAL && target[0].text.size() >= 2) name = target[0].text.substr(1, target[0].text.size() - 2);
+        else error(path, line, "malformed #include");
+
+        std::vector<std::string> candidates;
+        if (!system) candidates.push_back(directory_of(path) + "/" + name);
+        for (const auto& dir : include_paths) candidates.push_back(dir + "/" + name);
+        for (const auto& candidate : candidates) {
+            // Multiple-include optimization: a guarded header is not even read again.
+            auto guard = guards.find(candidate);
+            if (guard != guards.end() && macros.count(guard->second)) return;
+            std::string content;
+            if (!read_file(candidate, content)) continue;
+            process(candidate, content, out);
+            return;
+        }
+        // The analyzer knows `assert` natively, system headers can be missing.
+        if (system) report_err() << "Warning: " << path << ":" << line << ": cannot find <" << name << ">, skipping." << std::endl;
+        else error(path, line, "cannot find \"" + name + "\"");
+    }
+
+    void process(const std::string& path, const std::string& content, std::string& out) {
+        if (once.count(path)) return;
+        if (stack.size() >= max_depth) error(path, 1, "#include nested too deeply");
+        std::shared_ptr<const TokenizedFile> file = cache.get(path, content);
+        if (!file->guard.empty()) guards[path] = file->guard;
+        if (!file->guard.empty() && macros.count(file->guard)) return;
+        if (file->pragma_once) once.insert(path);
+        stack.push_back(path);
+        uint32_t source = static_cast<uint32_t>(std::find(map.files.begin(), map.files.end(), path) - map.files.begin());
+        if (source == map.files.size()) map.files.push_back(path);
+
+        // Each conditional level: whether its group is active, and whether a branch was taken.
+        struct Level { bool active; bool taken; bool parent_active; };
+        std::vector<Level> levels;
+        auto active = [&levels]() { return levels.empty() || levels.back().active; };
+        for (const auto& line : file->lines) {
+            const auto& toks = line.tokens;
+            if (!line.is_directive()) {
+                if (!active()) continue;
+                std::vector<PPToken> expanded = expand(toks, {});
+                map.starts.push_back(out.size());
+                map.lines.emplace_back(source, static_cast<uint32_t>(line.number));
+                for (size_t i = 0; i < expanded.size(); ++i) {
+                    if (i > 0 && expanded[i].space_before) out += ' ';
+                    out += expanded[i].text;
+                }
+                out += '\n';
+                continue;
+            }
+            std::string directive = toks.size() > 1 ? toks[1].text : "";
+            std::vector<PPToken> args(toks.begin() + std::min<size_t>(2, toks.size()), toks.end());
+            if (directive == "ifdef" || directive == "ifndef" || directive == "if") {
+                bool parent = active();
+                bool cond = false;
+                if (parent) {
+                    if (directive == "if") cond = evaluate_condition(args, path, line.number);
+                    else if (args.empty()) error(path, line.number, "#" + directive + " without a macro name");
+                    else cond = macros.count(args[0].text) == (directive == "ifdef" ? 1u : 0u);
+                }
+                levels.push_back(Level{parent && cond, parent && cond, parent});
+            }
+            else if (directive == "elif" || directive == "else") {
+                if (levels.empty()) error(path, line.number, "#" + directive + " without #if");
+                Level& l = levels.back();
+                bool cond = l.parent_active && !l.taken && (directive == "else" || evaluate_condition(args, path, line.number));
+                l.active = cond;
+                l.taken = l.taken || cond;
+            }
+            else if (directive == "endif") {
+                if (levels.empty()) error(path, line.number, "#endif without #if");
+                levels.pop_back();
+            }
+            else if (!active()) continue;
+            else if (directive == "define") define(toks, path, line.number);
+            else if (directive == "undef") { if (!args.empty()) macros.erase(args[0].text); }
+            else if (directive == "include") include(toks, path, line.number, out);
+            else if (directive == "error") error(path, line.number, "#error");
+            else if (directive != "pragma" && !directive.empty()) error(path, line.number, "unsupported directive #" + directive);
+        }
+        if (!levels.empty()) error(path, file->lines.empty() ? 1 : file->lines.back().number, "unterminated conditional");
+        stack.pop_back();
+    }
+
+public:
+    Preprocessor(const std::vector<std::string>& include_paths, HeaderCache& cache)
+        : include_paths(include_paths), cache(cache) {}
+
+    // Preprocessed text of the file at path, throws std::runtime_error on errors.
+    std::string preprocess_file(const std::string& path) {
+        std::string content;
+        if (!read_file(path, content)) throw std::runtime_error("cannot open `" + path + "`");
+        return preprocess(path, content);
+    }
+
+    std::string preprocess(const std::string& path, const std::string& content) {
+        macros.clear();
+        once.clear();
+        guards.clear();
+        stack.clear();
+        map = SourceMap();
+        std::string out;
+        process(path, content, out);
+        return out;
+    }
+
+    // Origins of the lines of the last preprocessed text, the file itself first.
+    const SourceMap& source_map() const { return map; }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Destination of the messages of the analysis on the current thread. They go
+// to std::cout and std::cerr, unless the thread captures them with a
+// ReportCapture: the reports of programs analyzed on different threads then
+// stay apart and can be merged in a fixed order.
+inline thread_local std::ostream* captured_report = nullptr;
+
+inline std::ostream& report_out() {
+    return captured_report != nullptr ? *captured_report : std::cout;
+}
+
+// Warnings and failed assertions. A captured report keeps them in place,
+// interleaved with the other messages.
+inline std::ostream& report_err() {
+    return captured_report != nullptr ? *captured_report : std::cerr;
+}
+
+class ReportCapture {
+private:
+    std::ostringstream buffer;
+    std::ostream* previous;
+
+public:
+    ReportCapture() : previous(captured_report) { captured_report = &buffer; }
+    ~ReportCapture() { captured_report = previous; }
+
+    ReportCapture(const ReportCapture&) = delete;
+    ReportCapture& operator=(const ReportCapture&) = delete;
+
+    std::string str() const { return buffer.str(); }
+};
+
+#endif
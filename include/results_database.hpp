@@ -0,0 +1,275 @@
+#ifndef RESULTS_DATABASE_HPP
+#define RESULTS_DATABASE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "interval.hpp"
+#include "interval_store.hpp"
+
+// Stores of every program point of an analysis, in a file made to be mapped
+// in memory and queried in place. Fixed-size native-endian records, each
+// table 8-byte aligned:
+//   Header
+//   Name[variables]        sorted by name: a variable id is its rank
+//   Name[files]            the analyzed file first, then its includes
+//   StoreRecord[stores]    deduplicated stores, each a run of entries
+//   Entry[entries]         sorted by variable id within a store
+//   LocationRecord[locations]
+//   Position[positions]    (file, line, location) sorted, the locations with a line
+//   char[string_bytes]     the names
+// The relational components and the arrays are not recorded.
+namespace results {
+constexpr char magic[8] = {'A', 'I', 'R', 'E', 'S', '0', '0', '1'};
+constexpr uint32_t bottom = 1;      // StoreRecord flags: the point is unreachable
+constexpr uint32_t empty = 1;       // Entry kind: the interval is empty
+
+struct Header {
+    char magic[8];
+    uint64_t variables, files, stores, entries, locations, positions, string_bytes;
+};
+struct Name { uint64_t offset, length; };
+struct StoreRecord { uint64_t first; uint32_t count, flags; };
+struct Entry { uint32_t variable, kind; int64_t lower, upper; };
+struct LocationRecord { uint32_t store, file, line, reserved; };     // line 0: no source line
+struct Position { uint32_t file, line, location, reserved; };
+}
+
+class ResultsDatabase {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    const results::Header* header = nullptr;
+    const results::Name* variables = nullptr;
+    const results::Name* files = nullptr;
+    const results::StoreRecord* stores = nullptr;
+    const results::Entry* entries = nullptr;
+    const results::LocationRecord* locations = nullptr;
+    const results::Position* positions = nullptr;
+    const char* strings = nullptr;
+
+    template <typename T>
+    static void put(std::ofstream& out, const std::vector<T>& table) {
+        out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(T)));
+    }
+
+    std::string_view name(const results::Name& n) const {
+        if (n.offset > header->string_bytes || n.length > header->string_bytes - n.offset)
+            throw std::runtime_error("corrupted results database");
+        return std::string_view(strings + n.offset, n.length);
+    }
+
+    const results::StoreRecord& store_of(size_t location) const {
+        if (location >= header->locations) throw std::runtime_error("no location " + std::to_string(location));
+        uint32_t store = locations[location].store;
+        if (store >= header->stores || stores[store].first > header->entries || stores[store].count > header->entries - stores[store].first)
+            throw std::runtime_error("corrupted results database");
+        return stores[store];
+    }
+
+    static Interval<int64_t> interval_of(const results::Entry& e) {
+        return e.kind & results::empty ? Interval<int64_t>::build_empty() : Interval<int64_t>(e.lower, e.upper);
+    }
+
+public:
+    // `stores[i]` is the store of the location i, `lines[i]` the file (an
+    // index in `sources`) and line of its statement, line 0 if it has none.
+    static void write(const std::string& path, const std::vector<const IntervalStore<int64_t>*>& point_stores,
+                      const std::vector<std::pair<uint32_t, uint32_t>>& lines, const std::vector<std::string>& sources) {
+        std::vector<std::string> names;
+        for (const auto* store : point_stores)
+            for (const auto& var : store->get_variables()) names.push_back(var);
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+
+        std::string string_table;
+        auto add_name = [&string_table](const std::string& s) {
+            results::Name n{string_table.size(), s.size()};
+            string_table += s;
+            return n;
+        };
+        std::vector<results::Name> variable_table, file_table;
+        for (const auto& var : names) variable_table.push_back(add_name(var));
+        for (const auto& file : sources) file_table.push_back(add_name(file));
+        string_table.resize((string_table.size() + 7) / 8 * 8, '\0');
+
+        // Stores with the same entries share one record.
+        std::vector<results::StoreRecord> store_table;
+        std::vector<results::Entry> entry_table;
+        std::vector<results::LocationRecord> location_table;
+        std::unordered_map<std::string, uint32_t> known;
+        std::vector<results::Entry> current;
+        for (size_t i = 0; i < point_stores.size(); ++i) {
+            const auto& store = *point_stores[i];
+            current.clear();
+            uint32_t flags = store.is_bottom() ? results::bottom : 0;
+            if (!store.is_bottom()) {
+                for (const auto& var : store.get_variables()) {
+                    Interval<int64_t> iv = store.get_interval(var);
+                    uint32_t id = static_cast<uint32_t>(std::lower_bound(names.begin(), names.end(), var) - names.begin());
+                    current.push_back(iv.isEmpty() ? results::Entry{id, results::empty, 0, 0} : results::Entry{id, 0, iv.getLower(), iv.getUpper()});
+                }
+                std::sort(current.begin(), current.end(), [](const auto& a, const auto& b) { return a.variable < b.variable; });
+            }
+            std::string key(reinterpret_cast<const char*>(&flags), sizeof(flags));
+            key.append(reinterpret_cast<const char*>(current.data()), current.size() * sizeof(results::Entry));
+            auto [it, inserted] = known.emplace(std::move(key), static_cast<uint32_t>(store_table.size()));
+            if (inserted) {
+                store_table.push_back(results::StoreRecord{entry_table.size(), static_cast<uint32_t>(current.size()), flags});
+                entry_table.insert(entry_table.end(), current.begin(), current.end());
+            }
+            auto [file, line] = i < lines.size() ? lines[i] : std::make_pair(0u, 0u);
+            location_table.push_back(results::LocationRecord{it->second, file, line, 0});
+        }
+
+        std::vector<results::Position> position_table;
+        for (size_t i = 0; i < location_table.size(); ++i)
+            if (location_table[i].line != 0)
+                position_table.push_back(results::Position{location_table[i].file, location_table[i].line, static_cast<uint32_t>(i), 0});
+        std::sort(position_table.begin(), position_table.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.file, a.line, a.location) < std::tie(b.file, b.line, b.location);
+        });
+
+        results::Header h;
+        std::memcpy(h.magic, results::magic, sizeof(h.magic));
+        h.variables = variable_table.size();
+        h.files = file_table.size();
+        h.stores = store_table.size();
+        h.entries = entry_table.size();
+        h.locations = location_table.size();
+        h.positions = position_table.size();
+        h.string_bytes = string_table.size();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) throw std::runtime_error("cannot write the results `" + path + "`");
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        put(out, variable_table);
+        put(out, file_table);
+        put(out, store_table);
+        put(out, entry_table);
+        put(out, location_table);
+        put(out, position_table);
+        out.write(string_table.data(), static_cast<std::streamsize>(string_table.size()));
+        out.close();
+        if (out.fail()) throw std::runtime_error("cannot write the results `" + path + "`");
+    }
+
+    explicit ResultsDatabase(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot read the results `" + path + "`");
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(results::Header)) {
+            ::close(fd);
+            throw std::runtime_error("`" + path + "` is not a results database");
+        }
+        size = static_cast<size_t>(st.st_size);
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) throw std::runtime_error("cannot map the results `" + path + "`");
+        data = static_cast<const char*>(mapped);
+        header = reinterpret_cast<const results::Header*>(data);
+
+        // Every table must fit in the file; the records are checked when read.
+        uint64_t counts[] = {header->variables, header->files, header->stores, header->entries, header->locations, header->positions, header->string_bytes};
+        size_t sizes[] = {sizeof(results::Name), sizeof(results::Name), sizeof(results::StoreRecord), sizeof(results::Entry),
+                          sizeof(results::LocationRecord), sizeof(results::Position), 1};
+        const char* tables[7];
+        uint64_t offset = sizeof(results::Header);
+        bool fits = std::memcmp(header->magic, results::magic, sizeof(results::magic)) == 0;
+        for (size_t k = 0; k < 7 && fits; ++k) {
+            tables[k] = data + offset;
+            fits = counts[k] <= (size - offset) / sizes[k];
+            offset += counts[k] * sizes[k];
+        }
+        if (!fits) {
+            ::munmap(const_cast<char*>(data), size);
+            throw std::runtime_error("`" + path + "` is not a results database");
+        }
+        variables = reinterpret_cast<const results::Name*>(tables[0]);
+        files = reinterpret_cast<const results::Name*>(tables[1]);
+        stores = reinterpret_cast<const results::StoreRecord*>(tables[2]);
+        entries = reinterpret_cast<const results::Entry*>(tables[3]);
+        locations = reinterpret_cast<const results::LocationRecord*>(tables[4]);
+        positions = reinterpret_cast<const results::Position*>(tables[5]);
+        strings = tables[6];
+    }
+
+    ~ResultsDatabase() { ::munmap(const_cast<char*>(data), size); }
+
+    ResultsDatabase(const ResultsDatabase&) = delete;
+    ResultsDatabase& operator=(const ResultsDatabase&) = delete;
+
+    size_t location_count() const { return header->locations; }
+
+    std::string_view file(uint32_t id) const {
+        if (id >= header->files) return "?";
+        return name(files[id]);
+    }
+
+    std::optional<uint32_t> file_id(std::string_view path) const {
+        for (uint32_t id = 0; id < header->files; ++id)
+            if (name(files[id]) == path) return id;
+        return std::nullopt;
+    }
+
+    // The file and line of the statement of a location, line 0 if none.
+    std::pair<uint32_t, uint32_t> position(size_t location) const {
+        if (location >= header->locations) throw std::runtime_error("no location " + std::to_string(location));
+        return {locations[location].file, locations[location].line};
+    }
+
+    // The locations of the statements of a line, in location order.
+    std::vector<size_t> locations_at(uint32_t file, uint32_t line) const {
+        auto range = std::equal_range(positions, positions + header->positions, results::Position{file, line, 0, 0},
+            [](const auto& a, const auto& b) { return std::tie(a.file, a.line) < std::tie(b.file, b.line); });
+        std::vector<size_t> found;
+        for (auto it = range.first; it != range.second; ++it) found.push_back(it->location);
+        return found;
+    }
+
+    bool is_bottom(size_t location) const { return store_of(location).flags & results::bottom; }
+
+    // The interval of `var` at the location, nullopt when the store does not
+    // hold it (or the location is unreachable).
+    std::optional<Interval<int64_t>> interval(size_t location, std::string_view var) const {
+        const auto& store = store_of(location);
+        auto begin = variables, end = variables + header->variables;
+        auto it = std::lower_bound(begin, end, var, [this](const results::Name& n, std::string_view v) { return name(n) < v; });
+        if (it == end || name(*it) != var) return std::nullopt;
+        uint32_t id = static_cast<uint32_t>(it - begin);
+        const results::Entry* first = entries + store.first;
+        const results::Entry* last = first + store.count;
+        auto entry = std::lower_bound(first, last, id, [](const results::Entry& e, uint32_t v) { return e.variable < v; });
+        if (entry == last || entry->variable != id) return std::nullopt;
+        return interval_of(*entry);
+    }
+
+    // Every variable of the store of the location, by name.
+    std::vector<std::pair<std::string_view, Interval<int64_t>>> intervals(size_t location) const {
+        const auto& store = store_of(location);
+        std::vector<std::pair<std::string_view, Interval<int64_t>>> found;
+        for (uint32_t k = 0; k < store.count; ++k) {
+            const auto& e = entries[store.first + k];
+            if (e.variable >= header->variables) throw std::runtime_error("corrupted results database");
+            found.emplace_back(name(variables[e.variable]), interval_of(e));
+        }
+        return found;
+    }
+};
+
+#endif
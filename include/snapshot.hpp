@@ -0,0 +1,104 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Publication of immutable snapshots with epoch-based reclamation (RCU).
+// A single writer publishes new versions with a pointer swap; any number of
+// readers pin the current version without taking a lock, so a reader never
+// waits for the writer and the writer never copies anything for the readers
+// nor waits for them. A replaced version is freed by a later publish() once
+// no reader that may still see it remains.
+template <typename T>
+class SnapshotPublisher {
+private:
+    // Epoch a reader pinned, 0 when the slot is free. One cache line each,
+    // so that readers on different cores do not share lines.
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    std::atomic<const T*> current{nullptr};
+    std::atomic<uint64_t> epoch{1};
+    std::vector<ReaderSlot> slots;
+    std::vector<std::pair<uint64_t, const T*>> retired;   // writer only
+
+    // The oldest epoch pinned by a reader, UINT64_MAX when there is none.
+    uint64_t oldest_reader() const {
+        uint64_t oldest = UINT64_MAX;
+        for (const auto& slot : slots) {
+            uint64_t e = slot.epoch.load();
+            if (e != 0 && e < oldest) oldest = e;
+        }
+        return oldest;
+    }
+
+public:
+    // Pinned version of the snapshot, valid until the guard is destroyed.
+    class ReadGuard {
+    private:
+        ReaderSlot* slot;
+        const T* snapshot;
+
+    public:
+        ReadGuard(ReaderSlot* slot, const T* snapshot) : slot(slot), snapshot(snapshot) {}
+        ReadGuard(ReadGuard&& other) noexcept : slot(other.slot), snapshot(other.snapshot) { other.slot = nullptr; }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard() { if (slot != nullptr) slot->epoch.store(0); }
+
+        // nullptr before the first publication.
+        const T* get() const { return snapshot; }
+        const T* operator->() const { return snapshot; }
+        const T& operator*() const { return *snapshot; }
+    };
+
+    explicit SnapshotPublisher(size_t max_readers = 64) : slots(max_readers) {}
+
+    ~SnapshotPublisher() {
+        delete current.load();
+        for (const auto& [e, old] : retired) delete old;
+    }
+
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    // Lock-free as long as fewer than max_readers readers hold a guard at once,
+    // a reader beyond that spins until a slot is released.
+    ReadGuard read() {
+        while (true) {
+            for (auto& slot : slots) {
+                uint64_t expected = 0;
+                if (slot.epoch.compare_exchange_strong(expected, epoch.load()))
+                    return ReadGuard(&slot, current.load());
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Writer side, not to be called concurrently with itself. The readers that
+    // pinned an epoch after the swap can only see the new version, so the old
+    // one is retired with the epoch of the swap and freed once all the pinned
+    // epochs are after it.
+    void publish(std::unique_ptr<const T> snapshot) {
+        const T* old = current.exchange(snapshot.release());
+        uint64_t swapped = epoch.fetch_add(1);
+        if (old != nullptr) retired.emplace_back(swapped, old);
+        uint64_t oldest = oldest_reader();
+        size_t kept = 0;
+        for (const auto& [e, ptr] : retired) {
+            if (e < oldest) delete ptr;
+            else retired[kept++] = {e, ptr};
+        }
+        retired.resize(kept);
+    }
+
+    size_t get_retired() const { return retired.size(); }
+};
+
+#endif
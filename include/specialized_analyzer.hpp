@@ -0,0 +1,355 @@
+#ifndef SPECIALIZED_ANALYZER_HPP
+#define SPECIALIZED_ANALYZER_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "abstract_interpeter.hpp"
+#include "analyzer_source.hpp"
+
+extern char **environ;
+
+// Where the generated analyzers find specialized_store.hpp, set by the build.
+#ifndef ABSINT_INCLUDE_DIR
+#define ABSINT_INCLUDE_DIR "include"
+#endif
+
+// The transfer functions of the locations emitted into an AnalyzerSource, a
+// location class at a time; the location classes only compute their stores.
+class LocationEmitter {
+private:
+    AnalyzerSource &source;
+
+    // The entry store never changes, its intervals are parameters.
+    bool emit(const declaration_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        const Store &store = loc.store;
+        if (!store.get_arrays().empty()) return source.fail("arrays");
+        if (!inputs.empty() || store.is_bottom() || store.has_known_bits() || store.has_affine_equalities() || store.get_equalities() != EqualityDomain())
+            return source.fail("a relational entry store");
+        source.entry(index, store);
+        return true;
+    }
+
+    bool emit(const assignment_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        const ASTNode &node = loc.get_node();
+        if (node.children[0].type == NodeType::ARRAY_ACCESS) return source.fail("arrays");
+        if (has_bitwise_op(node.children[1])) return source.fail("bitwise operations");
+        auto var = source.index_of(std::get<std::string>(node.children[0].value));
+        if (!var) return false;
+        std::string transfer = "Store n = in0;\n";
+        if (node.children[1].type == NodeType::VARIABLE) {
+            auto src = source.index_of(std::get<std::string>(node.children[1].value));
+            if (!src) return false;
+            transfer += "n.assign_variable(" + std::to_string(*var) + ", " + std::to_string(*src) + ");\n";
+        }
+        else {
+            auto value = source.arithmetic(node.children[1], "in0");
+            if (!value) return false;
+            transfer += "n.update_interval(" + std::to_string(*var) + ", " + *value + ");\n";
+        }
+        source.location(index, inputs, transfer + "return n;");
+        return true;
+    }
+
+    // The bounds are parameters of the analyzer.
+    bool emit(const precondition_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        const ASTNode &node = loc.get_node();
+        if (node.children.size() != 2) return source.fail("an invalid precondition");
+        auto var = source.index_of(std::get<std::string>(node.children[0].children[1].value));
+        if (!var) return false;
+        int64_t lb = std::get<int>(node.children[0].children[0].value);
+        int64_t ub = std::get<int>(node.children[1].children[0].value);
+        source.location(index, inputs, "Store n = in0;\nn.update_interval(" + std::to_string(*var) + ", " + source.parameter(Interval<int64_t>(lb, ub)) + ");\nreturn n;");
+        return true;
+    }
+
+    bool emit(const preif_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        std::string transfer = "Store n = in0;\n";
+        if (!loc.get_var().empty()) {
+            auto k = source.index_of(loc.get_var());
+            auto guard = source.logical(loc.get_guard(), "n");
+            if (!k || !guard) return false;
+            transfer += "n.refine_interval(" + std::to_string(*k) + ", " + *guard + ");\n";
+        }
+        source.location(index, inputs, transfer + "return n;");
+        return true;
+    }
+
+    bool emit(const condition_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        if (loc.get_var().empty()) {
+            source.location(index, inputs, "return in0;");
+            return true;
+        }
+        auto k = source.index_of(loc.get_var());
+        auto guard = source.logical(loc.get_guard(), "n");
+        if (!k || !guard) return false;
+        std::string v = std::to_string(*k);
+        source.location(index, inputs, "Store n = in0;\nn.refine_interval(" + v + ", " + *guard + ");\n"
+                                       "if (n.intervals[" + v + "].isEmpty()) return Store::bottom();\nreturn n;");
+        return true;
+    }
+
+    // As prewhile_location::transfer, the thresholds being tables of the
+    // analyzer, and the evaluations and the settled ones its counters.
+    bool emit(const prewhile_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        const LoopSettings &settings = loc.get_settings();
+        const auto &counted = loc.get_counted();
+        std::string transfer = "Store n = in0;\n";
+        for (size_t p = 1; p < inputs.size(); ++p) transfer += "n = n.join(in" + std::to_string(p) + ");\n";
+        std::string delay = std::to_string(settings.widening_delay), settled = source.counter();
+        transfer += "if (" + source.counter() + "++ > " + delay + " && !self.unreachable) {\n";
+        auto widen = [&](const std::string &v, const std::vector<int64_t> &thresholds) {
+            auto k = source.index_of(v);
+            if (!k) return false;
+            std::string at = "n.intervals[" + std::to_string(*k) + "]", old = "self.intervals[" + std::to_string(*k) + "]";
+            transfer += "    n.widen_interval(" + std::to_string(*k) + ", widen_to_thresholds(" + old + ", " + at + ", "
+                      + source.table(thresholds) + ", true));\n";
+            return true;
+        };
+        transfer += "if (" + settled + " > " + delay + ") {\n";
+        for (const auto &v : source.get_variables())
+            if (loc.get_guard_vars().count(v) == 0 && !(counted && counted->accelerates(v)) && !widen(v, loc.var_thresholds(v))) return false;
+        transfer += "}\n";
+        if (!counted) {
+            for (const auto &v : loc.get_guard_vars())
+                if (!widen(v, loc.guard_var_thresholds(v))) return false;
+        }
+        transfer += "}\n";
+        if (counted) transfer += source.counted_loop(*counted) + ".accelerate_head(in0, n);\n";
+        transfer += "if (n.unreachable) return n;\n";
+        if (!loc.get_var().empty() && loc.get_guard().type == NodeType::LOGIC_OP) {
+            auto k = source.index_of(loc.get_var());
+            auto guard = source.logical(loc.get_guard(), "n");
+            if (!k || !guard) return false;
+            transfer += "n.refine_interval(" + std::to_string(*k) + ", " + *guard + ");\n";
+        }
+        std::string unchanged = "!self.unreachable";
+        for (const auto &v : loc.get_guard_vars()) {
+            auto k = source.index_of(v);
+            if (!k) return false;
+            unchanged += " && self.intervals[" + std::to_string(*k) + "] == n.intervals[" + std::to_string(*k) + "]";
+        }
+        transfer += settled + " = " + unchanged + " ? " + settled + " + 1 : 0;\n";
+        source.location(index, inputs, transfer + "return n;");
+        return true;
+    }
+
+    bool emit(const postwhile_location &loc, size_t index, const std::vector<size_t> &inputs) {
+        std::string transfer = "Store n = in0;\n";
+        for (size_t p = 1; p + 1 < inputs.size(); ++p) transfer += "n = n.join(in" + std::to_string(p) + ");\n";
+        // The entries failing the guard skip the body.
+        std::string entry = "in" + std::to_string(inputs.size() - 1);
+        if (!loc.get_var().empty()) {
+            auto k = source.index_of(loc.get_var());
+            auto guard = source.logical(loc.get_guard(), "n");
+            auto skipped = source.logical(loc.get_guard(), "skipped");
+            if (!k || !guard || !skipped) return false;
+            std::string v = std::to_string(*k);
+            transfer += "n.refine_interval(" + v + ", " + *guard + ");\n"
+                        "Store skipped = " + entry + ";\nskipped.refine_interval(" + v + ", " + *skipped + ");\n"
+                        "if (!skipped.intervals[" + v + "].isEmpty()) n = n.join(skipped);\n";
+            if (loc.get_counted()) transfer += source.counted_loop(*loc.get_counted()) + ".accelerate_exit(" + entry + ", n);\n";
+        }
+        else transfer += "n = n.join(" + entry + ");\n";
+        source.location(index, inputs, transfer + "return n;");
+        return true;
+    }
+
+    // Location `index`, `inputs` being the locations of its deps.
+    bool emit(const location &loc, size_t index, const std::vector<size_t> &inputs) {
+        if (auto l = dynamic_cast<const declaration_location*>(&loc)) return emit(*l, index, inputs);
+        if (auto l = dynamic_cast<const assignment_location*>(&loc)) return emit(*l, index, inputs);
+        if (auto l = dynamic_cast<const precondition_location*>(&loc)) return emit(*l, index, inputs);
+        if (auto l = dynamic_cast<const preif_location*>(&loc)) return emit(*l, index, inputs);
+        if (auto l = dynamic_cast<const condition_location*>(&loc)) return emit(*l, index, inputs);
+        if (auto l = dynamic_cast<const prewhile_location*>(&loc)) return emit(*l, index, inputs);
+        if (auto l = dynamic_cast<const postwhile_location*>(&loc)) return emit(*l, index, inputs);
+        if (dynamic_cast<const ifelse_location*>(&loc)) {
+            source.location(index, inputs, "return in0.join(in1);");
+            return true;
+        }
+        if (dynamic_cast<const join_location*>(&loc)) {
+            std::string transfer = "Store n = in0;\n";
+            for (size_t p = 1; p < inputs.size(); ++p) transfer += "n = n.join(in" + std::to_string(p) + ");\n";
+            source.location(index, inputs, transfer + "return n;");
+            return true;
+        }
+        if (dynamic_cast<const jump_location*>(&loc)) {
+            source.location(index, inputs, "return Store::bottom();");
+            return true;
+        }
+        // The stores of a generated analyzer hold the same variables everywhere.
+        if (dynamic_cast<const local_declaration_location*>(&loc)) return source.fail("declarations inside blocks");
+        return source.fail("an unsupported statement");
+    }
+
+public:
+    explicit LocationEmitter(AnalyzerSource &source) : source(source) {}
+
+    // Emits every location of `interpreter`, false when one of them cannot be.
+    bool emit(AbstractInterpreter &interpreter) {
+        if (interpreter.has_affine_equalities() || interpreter.prunes_dead_variables()) return source.fail("--karr or --prune-dead");
+        const auto &locations = interpreter.get_locations();
+        LocationGraph graph(locations);
+        for (size_t i = 0; i < locations.size(); ++i)
+            if (!emit(*locations[i], i, graph.inputs[i])) return source.fail("location " + std::to_string(i));
+        return true;
+    }
+};
+
+// Ahead-of-time analyzers: the locations of a program are emitted as the C++
+// source of an analyzer specialized to it (AnalyzerSource), which the system
+// compiler ($CXX, c++ by default) builds into a shared library of the cache
+// directory, named after the hash of the source, of the headers it includes
+// and of the compiler command, and loaded with dlopen. The source does not
+// depend on the initial values nor on the bounds of the preconditions, so the
+// next runs on the program load the library without compiling it.
+class SpecializedAnalyzer {
+private:
+    std::string cache;
+
+    using Run = uint64_t (*)(const int64_t*, uint8_t*, int64_t*, uint32_t*);
+
+    // The headers the generated source includes, directly or not: a change to
+    // one of them changes the library.
+    static constexpr const char *headers[] = {"specialized_store.hpp", "interval_transfer.hpp", "counted_loop.hpp", "interval.hpp", "ast.hpp"};
+
+    // The compiler command without its output and input: $CXX split at the
+    // blanks, then the flags.
+    static std::vector<std::string> compiler() {
+        const char *cxx = std::getenv("CXX");
+        std::istringstream words(cxx != nullptr ? cxx : "");
+        std::vector<std::string> command{std::istream_iterator<std::string>(words), std::istream_iterator<std::string>()};
+        if (command.empty()) command.push_back("c++");
+        for (const char *flag : {"-std=c++17", "-O2", "-shared", "-fPIC"}) command.push_back(flag);
+        command.push_back(std::string("-I") + ABSINT_INCLUDE_DIR);
+        return command;
+    }
+
+    // What the library is built from, hashed to name it: the source, the
+    // headers and the compiler command.
+    static std::string dependencies(const std::string &text, const std::vector<std::string> &command) {
+        std::string key = text;
+        for (const char *header : headers) {
+            std::ifstream in(std::filesystem::path(ABSINT_INCLUDE_DIR) / header, std::ios::binary);
+            key += '\0';
+            key.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        for (const auto &arg : command) key += '\0' + arg;
+        return key;
+    }
+
+    // Runs `command` without a shell, true when it exits with 0.
+    static bool run(const std::vector<std::string> &command) {
+        std::vector<char*> argv;
+        for (const auto &arg : command) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        pid_t pid;
+        if (::posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return false;
+        int status;
+        while (::waitpid(pid, &status, 0) < 0)
+            if (errno != EINTR) return false;
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    // Compiles `source` into `library` through temporary files of this
+    // process, the library renamed once complete: a concurrent run never
+    // loads a partial library nor compiles a source being written. The
+    // source is kept when it does not compile.
+    void build(const std::string &source, const std::string &library, std::vector<std::string> command) const {
+        std::string temporary = library + "." + std::to_string(::getpid());
+        std::string path = library.substr(0, library.size() - 3) + "." + std::to_string(::getpid()) + ".cpp";
+        std::ofstream out(path, std::ios::trunc);
+        out << source;
+        out.close();
+        if (out.fail()) throw std::runtime_error("cannot write the specialized analyzer `" + path + "`");
+        command.insert(command.end(), {"-o", temporary, path});
+        report_out() << "Compiling the specialized analyzer `" << path << "`..." << std::endl;
+        if (!run(command)) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("cannot compile the specialized analyzer `" + path + "`");
+        }
+        std::remove(path.c_str());
+        std::error_code ec;
+        std::filesystem::rename(temporary, library, ec);
+        if (ec) throw std::runtime_error("cannot write the specialized analyzer `" + library + "`");
+    }
+
+public:
+    explicit SpecializedAnalyzer(const std::string &cache) : cache(cache) {}
+
+    // Solves the locations of `interpreter` with the analyzer specialized to
+    // them, leaving the fixpoint in their stores, and returns the number of
+    // sweeps (the iterations of eval_all); nullopt, with the reason in `why`,
+    // when the program cannot be specialized. Throws when the analyzer cannot
+    // be built or loaded.
+    std::optional<uint64_t> solve(AbstractInterpreter &interpreter, std::string &why) const {
+        auto &locations = interpreter.get_locations();
+        if (locations.empty()) {
+            why = "no locations";
+            return std::nullopt;
+        }
+        std::vector<std::string> names = locations[0]->store.get_variables();
+        AnalyzerSource source(names);
+        if (!LocationEmitter(source).emit(interpreter)) {
+            why = source.failure();
+            return std::nullopt;
+        }
+        std::string text = source.text();
+
+        std::error_code ec;
+        std::filesystem::create_directories(cache, ec);
+        std::vector<std::string> command = compiler();
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(std::hash<std::string>{}(dependencies(text, command))));
+        std::string library = (std::filesystem::path(cache) / ("absint-" + std::string(hash) + ".so")).string();
+        if (!std::filesystem::exists(library)) build(text, library, command);
+
+        void *handle = ::dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr) throw std::runtime_error("cannot load the specialized analyzer `" + library + "`: " + ::dlerror());
+        auto shape = reinterpret_cast<const uint64_t*>(::dlsym(handle, "absint_specialized_shape"));
+        auto run = reinterpret_cast<Run>(::dlsym(handle, "absint_specialized_run"));
+        size_t n = names.size(), count = locations.size();
+        if (shape == nullptr || run == nullptr || shape[0] != count || shape[1] != n || shape[2] != source.parameters().size() / 2) {
+            ::dlclose(handle);
+            throw std::runtime_error("`" + library + "` is not the analyzer of this program");
+        }
+        std::vector<uint8_t> unreachable(count);
+        std::vector<int64_t> bounds(2 * count * n);
+        std::vector<uint32_t> classes(count * n);
+        uint64_t sweeps = run(source.parameters().data(), unreachable.data(), bounds.data(), classes.data());
+        ::dlclose(handle);
+
+        for (size_t i = 0; i < count; ++i) {
+            if (unreachable[i]) {
+                locations[i]->store = Store::bottom();
+                continue;
+            }
+            Store store;
+            for (size_t k = 0; k < n; ++k)
+                store.update_interval(names[k], Interval<int64_t>(bounds[2 * (i * n + k)], bounds[2 * (i * n + k) + 1]));
+            for (size_t k = 0; k < n; ++k)
+                if (classes[i * n + k] != k) store.assign_variable(names[k], names[classes[i * n + k]]);
+            locations[i]->store = std::move(store);
+        }
+        return sweeps;
+    }
+};
+
+#endif
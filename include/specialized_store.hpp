@@ -0,0 +1,164 @@
+#ifndef SPECIALIZED_STORE_HPP
+#define SPECIALIZED_STORE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "interval.hpp"
+#include "interval_transfer.hpp"
+#include "counted_loop.hpp"
+
+// The runtime of the analyzers generated for a program (see
+// specialized_analyzer.hpp), which only include this header.
+
+// IntervalStore of a fixed set of N variables, known when the analyzer is
+// generated: variable k is the k-th name of Names::value, in the order of
+// the names. The intervals are an array indexed by the variable, and the
+// equalities (b = a) a partition where every variable holds the smallest
+// variable of its class. Every store of a program holds all its variables,
+// so the operations are the ones of IntervalStore on a complete store.
+template <size_t N, typename Names>
+class SpecializedStore {
+public:
+    bool unreachable = false;
+    std::array<Interval<int64_t>, N> intervals;
+    std::array<uint32_t, N> classes;
+
+    SpecializedStore() {
+        for (size_t k = 0; k < N; ++k) classes[k] = static_cast<uint32_t>(k);
+    }
+
+    static SpecializedStore bottom() {
+        SpecializedStore store;
+        store.unreachable = true;
+        return store;
+    }
+
+    bool is_bottom() const { return unreachable; }
+
+    // var receives a new value, it leaves its class; when it was the
+    // smallest variable of the class, the next one takes its place.
+    void update_interval(size_t var, const Interval<int64_t>& interval) {
+        intervals[var] = interval;
+        forget(var);
+    }
+
+    void forget(size_t var) {
+        if (classes[var] == var) {
+            uint32_t next = static_cast<uint32_t>(N);
+            for (size_t k = var + 1; k < N; ++k) {
+                if (classes[k] != var) continue;
+                if (next == N) next = static_cast<uint32_t>(k);
+                classes[k] = next;
+            }
+        }
+        classes[var] = static_cast<uint32_t>(var);
+    }
+
+    // `dst = src`: dst takes the interval of src and joins its class.
+    void assign_variable(size_t dst, size_t src) {
+        intervals[dst] = intervals[src];
+        if (dst == src) return;
+        forget(dst);
+        uint32_t rep = classes[src];
+        if (dst > rep) {
+            classes[dst] = rep;
+            return;
+        }
+        for (size_t k = rep; k < N; ++k)
+            if (classes[k] == rep) classes[k] = static_cast<uint32_t>(dst);
+    }
+
+    // Guard refinement: var and all the variables equal to it are narrowed.
+    void refine_interval(size_t var, const Interval<int64_t>& interval) {
+        uint32_t rep = classes[var];
+        for (size_t k = rep; k < N; ++k)
+            if (classes[k] == rep) intervals[k] = interval.meet(intervals[k]);
+    }
+
+    void widen_interval(size_t var, const Interval<int64_t>& interval) {
+        uint32_t rep = classes[var];
+        for (size_t k = rep; k < N; ++k)
+            if (classes[k] == rep) intervals[k] = interval;
+    }
+
+    // By name, for CountedLoop: an unknown variable is top, as in IntervalStore.
+    static size_t index_of(const std::string& var) {
+        for (size_t k = 0; k < N; ++k)
+            if (var == Names::value[k]) return k;
+        return N;
+    }
+
+    Interval<int64_t> get_interval(const std::string& var) const {
+        size_t k = index_of(var);
+        return k < N ? intervals[k] : Interval<int64_t>();
+    }
+
+    void set_interval(const std::string& var, const Interval<int64_t>& interval) {
+        size_t k = index_of(var);
+        if (k < N) update_interval(k, interval);
+    }
+
+    // Two variables stay equal only if they are equal in both stores: k
+    // joins the smallest variable before it in both of its classes.
+    SpecializedStore join(const SpecializedStore& other) const {
+        if (unreachable) return other;
+        if (other.unreachable) return *this;
+        SpecializedStore result;
+        for (size_t k = 0; k < N; ++k) {
+            result.intervals[k] = intervals[k].join(other.intervals[k]);
+            for (size_t j = classes[k]; j < k; ++j) {
+                if (classes[j] == classes[k] && other.classes[j] == other.classes[k]) {
+                    result.classes[k] = static_cast<uint32_t>(j);
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    // The intervals of an unreachable store are not compared.
+    bool operator==(const SpecializedStore& other) const {
+        return unreachable == other.unreachable && (unreachable || (intervals == other.intervals && classes == other.classes));
+    }
+};
+
+// The stores of the locations during the sweeps of the generated analyzer,
+// the evaluation counters of its loop heads, and its parameters: the bounds
+// of the entry store and of the preconditions, lower and upper in a row.
+template <typename Store, size_t Counters>
+struct SpecializedState {
+    const int64_t* parameters;
+    std::vector<Store> stores;
+    std::array<uint32_t, Counters> counters{};
+
+    SpecializedState(const int64_t* parameters, size_t locations) : parameters(parameters), stores(locations, Store::bottom()) {}
+
+    Interval<int64_t> parameter(size_t k) const { return Interval<int64_t>(parameters[2 * k], parameters[2 * k + 1]); }
+
+    // Returns true when the store of the location did not change.
+    bool update(size_t location, Store&& store) {
+        bool unchanged = stores[location] == store;
+        stores[location] = std::move(store);
+        return unchanged;
+    }
+
+    // The fixpoint, for every location: whether it is unreachable, then the
+    // bounds and the class of every variable.
+    void write(uint8_t* unreachable, int64_t* bounds, uint32_t* classes) const {
+        size_t n = stores.empty() ? 0 : stores[0].intervals.size();
+        for (size_t i = 0; i < stores.size(); ++i) {
+            unreachable[i] = stores[i].unreachable;
+            for (size_t k = 0; k < n; ++k) {
+                bounds[2 * (i * n + k)] = stores[i].intervals[k].getLower();
+                bounds[2 * (i * n + k) + 1] = stores[i].intervals[k].getUpper();
+                classes[i * n + k] = stores[i].classes[k];
+            }
+        }
+    }
+};
+
+#endif
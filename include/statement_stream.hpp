@@ -0,0 +1,169 @@
+#ifndef STATEMENT_STREAM_HPP
+#define STATEMENT_STREAM_HPP
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast.hpp"
+#include "parallel_parser.hpp"
+#include "parser.hpp"
+#include "report.hpp"
+
+// A source file mapped read-only: its pages are read as the stream reaches
+// them, and dropped by the system as they are left behind.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open `" + path + "`");
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot map `" + path + "`");
+        }
+        size = static_cast<size_t>(st.st_size);
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) throw std::runtime_error("cannot map `" + path + "`");
+        data = static_cast<const char*>(mapped);
+        ::madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+
+    ~MappedFile() { ::munmap(const_cast<char*>(data), size); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view text() const { return std::string_view(data, size); }
+};
+
+// The top-level statements of `main`, parsed a window of about window_size
+// bytes at a time: only the nodes of the current window are in memory. open()
+// only scans the globals and the first statements; the others are delimited
+// (see StatementScanner) as their window is reached, so a body that does not
+// split into statements is reported when the stream gets there.
+class StatementStream {
+private:
+    std::string_view input;
+    StatementScanner scanner;
+    AbstractInterpreterParser parser;
+    size_t window_size;
+    size_t pos = 0;
+    bool done = false;
+    size_t line = 1, line_pos = 0;   // line of line_pos, the start of the current window
+    ASTNode global_root;
+
+    size_t line_of(size_t at) {
+        line += std::count(input.begin() + line_pos, input.begin() + at, '\n');
+        line_pos = at;
+        return line;
+    }
+
+public:
+    static constexpr size_t default_window_size = 1 << 16;
+
+    explicit StatementStream(std::string_view input, size_t window_size = default_window_size)
+        : input(input), scanner(input), window_size(std::max<size_t>(1, window_size)) {}
+
+    // Whether `text` can be streamed as it is, without being preprocessed:
+    // no directive, line continuation nor comment but the preconditions.
+    static bool plain(std::string_view text) {
+        if (text.find('#') != std::string_view::npos || text.find("//") != std::string_view::npos || text.find("\\\n") != std::string_view::npos)
+            return false;
+        for (size_t at = text.find("/*"); at != std::string_view::npos; at = text.find("/*", at + 2))
+            if (text.compare(at, 6, "/*!npk") != 0) return false;
+        return true;
+    }
+
+    // Parses the globals and checks that the body of `main` starts with two
+    // statements and that nothing follows it; false when the source is to be
+    // parsed as a whole.
+    bool open() {
+        auto main = scanner.find_main_start();
+        if (!main) return false;
+        auto [main_begin, body_begin] = *main;
+        size_t last = input.find_last_not_of(" \t\r\n");
+        if (last == std::string_view::npos || input[last] != '}') return false;
+        std::vector<size_t> comments;
+        auto globals = scanner.statements(0, main_begin, comments);
+        if (!globals) return false;
+        // The parser makes a single statement the body itself, not a SEQUENCE.
+        std::vector<size_t> ignored;
+        size_t first = scanner.next_statement(body_begin, input.size(), ignored);
+        auto stop = first < input.size() && input[first] != '}' ? scanner.statement_end(first, input.size()) : std::nullopt;
+        if (!stop) return false;
+        size_t second = scanner.next_statement(*stop, input.size(), ignored);
+        if (second >= input.size() || input[second] == '}') return false;
+        if (!globals->empty()) {
+            ASTNode parsed;
+            if (!parser.try_parse(std::string(input.substr(0, main_begin)), parsed)) return false;
+            size_t items = globals->size() + StatementScanner::comments_in(comments, 0, main_begin);
+            if (!StatementScanner::collect(parsed, globals->size(), items, global_root.children)) return false;
+        }
+        pos = first;
+        return true;
+    }
+
+    // The root of the globals, DECLARATION and ARRAY_DECL children.
+    const ASTNode& globals() const { return global_root; }
+
+    // The next statements of `main`, at least one, nullopt after the last
+    // one. Throws when a window does not split into statements or does not
+    // parse.
+    std::optional<std::vector<ASTNode>> next() {
+        if (done) return std::nullopt;
+        std::vector<size_t> comments;
+        size_t begin = pos, end = pos, count = 0;
+        line_of(begin);
+        while (count == 0 || pos - begin < window_size) {
+            if (pos < input.size() && input[pos] == '}') {
+                // The brace closing `main`: only blanks follow (see open).
+                if (input.find_first_not_of(" \t\r\n", pos + 1) != std::string_view::npos)
+                    throw std::runtime_error("unexpected `}` at line " + std::to_string(line_of(pos)));
+                done = true;
+                break;
+            }
+            auto stop = pos < input.size() ? scanner.statement_end(pos, input.size()) : std::nullopt;
+            if (!stop) throw std::runtime_error("cannot split the statements of `main` from line " + std::to_string(line_of(pos)));
+            end = *stop;
+            pos = scanner.next_statement(end, input.size(), comments);
+            count++;
+        }
+        if (count == 0) return std::nullopt;
+        ASTNode parsed;
+        std::vector<ASTNode> nodes;
+        bool ok;
+        {
+            // Lines relative to the window: the error below gives the real one.
+            ReportCapture discarded;
+            ok = parser.try_parse(std::string(input.substr(begin, end - begin)), parsed);
+        }
+        size_t items = count + StatementScanner::comments_in(comments, begin, end);
+        if (!ok || !StatementScanner::collect(parsed, count, items, nodes))
+            throw std::runtime_error("cannot parse the statements from line " + std::to_string(line_of(begin)));
+        for (auto& node : nodes) shift_offsets(node, begin);
+        return nodes;
+    }
+
+    // The line of `offset` in the source, an offset of the globals or of the
+    // window last returned by next().
+    size_t line_at(size_t offset) const {
+        if (offset < line_pos) return 1 + std::count(input.begin(), input.begin() + offset, '\n');
+        return line + std::count(input.begin() + line_pos, input.begin() + offset, '\n');
+    }
+};
+
+#endif
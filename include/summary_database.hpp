@@ -0,0 +1,79 @@
+#ifndef SUMMARY_DATABASE_HPP
+#define SUMMARY_DATABASE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Exit state of a translation unit, restricted to its global variables, and
+// the alarms its analysis raised.
+struct UnitSummary {
+    uint64_t source_hash = 0;   // hash of the preprocessed unit
+    uint64_t input_hash = 0;    // hash of the settings and the entry intervals of its globals
+    std::map<std::string, std::pair<int64_t, int64_t>> exit;
+    std::vector<std::string> alarms;
+};
+
+// Persistent database of the unit summaries, a line per unit followed by a
+// line per alarm of the unit:
+//   unit <path> <source hash> <input hash> (<var> <lower> <upper>)*
+//   alarm <message>
+// A summary is reused as long as both the unit and its inputs are unchanged.
+class SummaryDatabase {
+private:
+    std::map<std::string, UnitSummary> units;
+
+public:
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in.is_open()) return false;
+        std::string line;
+        UnitSummary* last = nullptr;
+        while (std::getline(in, line)) {
+            if (line.rfind("alarm ", 0) == 0) {
+                if (last != nullptr) last->alarms.push_back(line.substr(6));
+                continue;
+            }
+            last = nullptr;
+            std::istringstream fields(line);
+            std::string tag, unit, var;
+            UnitSummary summary;
+            if (!(fields >> tag >> unit >> std::hex >> summary.source_hash >> summary.input_hash >> std::dec) || tag != "unit")
+                continue;
+            int64_t lower, upper;
+            while (fields >> var >> lower >> upper) summary.exit[var] = {lower, upper};
+            last = &(units[unit] = summary);
+        }
+        return true;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        for (const auto& [unit, summary] : units) {
+            out << "unit " << unit << " " << std::hex << summary.source_hash << " " << summary.input_hash << std::dec;
+            for (const auto& [var, bound] : summary.exit) out << " " << var << " " << bound.first << " " << bound.second;
+            out << "\n";
+            for (const auto& alarm : summary.alarms) out << "alarm " << alarm << "\n";
+        }
+        return true;
+    }
+
+    std::optional<UnitSummary> lookup(const std::string& unit, uint64_t source_hash, uint64_t input_hash) const {
+        auto it = units.find(unit);
+        if (it == units.end() || it->second.source_hash != source_hash || it->second.input_hash != input_hash)
+            return std::nullopt;
+        return it->second;
+    }
+
+    void record(const std::string& unit, const UnitSummary& summary) {
+        units[unit] = summary;
+    }
+};
+
+#endif
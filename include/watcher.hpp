@@ -0,0 +1,141 @@
+#ifndef WATCHER_HPP
+#define WATCHER_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Writes `content` to a temporary file next to `path` and renames it over
+// `path`, so a reader never sees a partially written file.
+bool write_atomically(const std::string& path, const std::string& content) {
+    std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+    }
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << content;
+        out.flush();
+        if (!out) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Paths changed below the watched root. When the kernel queue overflowed the
+// events were lost: anything may have changed and the whole tree is rescanned.
+struct WatchedChanges {
+    std::set<std::string> paths;
+    bool overflow = false;
+
+    bool empty() const { return paths.empty() && !overflow; }
+};
+
+// Watches a directory tree with inotify, including the directories created
+// after it started. A directory given as `ignored` (e.g. the output directory
+// when it lies inside the tree) is not watched.
+class DirectoryWatcher {
+private:
+    int fd = -1;
+    std::string root;
+    std::string ignored;
+    std::map<int, std::string> directories;   // watch descriptor -> directory
+
+    static constexpr uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DELETE_SELF;
+
+    bool is_ignored(const std::filesystem::path& dir) const {
+        if (ignored.empty()) return false;
+        std::error_code ec;
+        return std::filesystem::equivalent(dir, ignored, ec);
+    }
+
+    void watch_tree(const std::filesystem::path& root) {
+        if (is_ignored(root)) return;
+        int wd = inotify_add_watch(fd, root.c_str(), mask);
+        if (wd < 0) {
+            std::cerr << "WARNING: cannot watch `" << root.string() << "`: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        directories[wd] = root.string();
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+            if (entry.is_directory(ec) && !entry.is_symlink(ec)) watch_tree(entry.path());
+        }
+    }
+
+    // Reads the pending events, returns false when there were none.
+    bool read_events(WatchedChanges& changed) {
+        alignas(struct inotify_event) char buffer[16 * 1024];
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) return false;
+        for (char* p = buffer; p < buffer + length;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            // Comes with wd -1. The directories created meanwhile were
+            // missed too: the tree is watched again.
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed.overflow = true;
+                watch_tree(root);
+                continue;
+            }
+            auto dir = directories.find(event->wd);
+            if (dir == directories.end()) continue;
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                directories.erase(dir);
+                continue;
+            }
+            if (event->len == 0) continue;
+            std::filesystem::path path = std::filesystem::path(dir->second) / event->name;
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) watch_tree(path);
+            changed.paths.insert(path.string());
+        }
+        return true;
+    }
+
+public:
+    DirectoryWatcher(const std::string& root, const std::string& ignored = "") : root(root), ignored(ignored) {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) throw std::runtime_error(std::string("inotify: ") + std::strerror(errno));
+        watch_tree(root);
+    }
+
+    ~DirectoryWatcher() {
+        if (fd >= 0) close(fd);
+    }
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Blocks until something changes below the root, then keeps collecting the
+    // events until the tree stayed quiet for `debounce`, so that a burst of
+    // edits (an editor saving through a temporary file, a `git checkout`)
+    // gives a single batch.
+    WatchedChanges wait_changes(std::chrono::milliseconds debounce) {
+        WatchedChanges changed;
+        struct pollfd pfd = {fd, POLLIN, 0};
+        while (changed.empty()) {
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("poll: ") + std::strerror(errno));
+            while (read_events(changed)) {}
+        }
+        while (poll(&pfd, 1, static_cast<int>(debounce.count())) > 0) {
+            while (read_events(changed)) {}
+        }
+        return changed;
+    }
+};
+
+#endif
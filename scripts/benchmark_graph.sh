@@ -0,0 +1,29 @@
+#!/bin/sh
+# Times the construction of the location graph on generated programs of
+# growing sizes (scripts/generate_program.sh, 200 variables): the locations,
+# the build time and the heap growth during the build, and the solving time,
+# as --timings reports them. The Jacobi solver keeps the per-location stores
+# out of the output.
+#
+#   scripts/benchmark_graph.sh build/absint [statements...]
+set -u
+
+absint=${1:-build/absint}
+[ $# -gt 0 ] && shift
+sizes=${*:-1000 4000 16000}
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+status=0
+
+for statements in $sizes; do
+    sh "$root/scripts/generate_program.sh" 7 "$statements" 200 > "$work/program.c"
+    if ! "$absint" --timings --solver jacobi --solver-threads 1 "$work/program.c" > "$work/output" 2>&1; then
+        echo "$statements statements: the analysis fails"
+        status=1
+        continue
+    fi
+    printf '%s statements: %s\n' "$statements" "$(grep -E '^(Location graph|Fixpoint):' "$work/output" | tr '\n' ' ' | sed 's/ $//')"
+done
+
+exit $status
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Checks that the output does not depend on the number of threads: the
+# programs of tests/ and generated ones are analyzed with 1 to `threads`
+# threads, in batch mode and by each solver of --deterministic, and every
+# output is compared byte for byte with the one of a single thread. A source
+# of more than 1 MiB also checks the parallel parser, and the modes whose
+# output is reproducible must refuse the asynchronous solver.
+#
+#   scripts/check_determinism.sh build/absint [threads]
+set -u
+
+absint=${1:-build/absint}
+threads=${2:-4}
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for seed in 1 2 3; do
+    sh "$root/scripts/generate_program.sh" "$seed" 200 12 > "$work/generated$seed.c"
+done
+programs="$root/tests/*.c $work/generated*.c"
+sh "$root/scripts/generate_program.sh" 4 40000 12 > "$work/large.c"
+status=0
+
+# check <name> <command...>: runs the command with ABSINT_THREADS set to 1 to
+# `threads`, and compares the outputs.
+check() {
+    label=$1
+    shift
+    n=1
+    result="ok  "
+    while [ "$n" -le "$threads" ]; do
+        ABSINT_THREADS=$n
+        eval "$*" > "$work/$label.$n" 2>&1
+        if [ "$n" -gt 1 ] && ! cmp -s "$work/$label.1" "$work/$label.$n"; then
+            diff "$work/$label.1" "$work/$label.$n" | head -20
+            result="FAIL"
+            status=1
+        fi
+        n=$((n + 1))
+    done
+    rm -f "$work/$label".*
+    echo "$result $label"
+}
+
+check batch '"$absint" --batch --deterministic --jobs $ABSINT_THREADS -I "$root/tests/include" $programs'
+for program in $programs; do
+    name=$(basename "$program" .c)
+    check "$name.sequential" '"$absint" --deterministic --parse-threads $ABSINT_THREADS -I "$root/tests/include" "$program"'
+    check "$name.jacobi" '"$absint" --deterministic --solver jacobi --solver-threads $ABSINT_THREADS -I "$root/tests/include" "$program"'
+done
+program=$work/large.c
+check large.parser '"$absint" --deterministic --parse-threads $ABSINT_THREADS "$program"'
+
+for mode in --deterministic --batch "--results $work/results.db" "--summaries $work/summaries.db"; do
+    if "$absint" $mode --solver async "$root/tests/while.c" > "$work/async" 2>&1 || ! grep -q '^\[ERROR\]' "$work/async"; then
+        echo "FAIL ${mode%% *} accepts --solver async"
+        status=1
+    else
+        echo "ok   ${mode%% *} refuses --solver async"
+    fi
+done
+
+exit $status
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Checks that a --history log replays the fixpoint: the programs of tests/ and
+# a generated one are analyzed without --history, and the intervals printed
+# for every location at the last iteration must be the ones
+# `--history-query log location` rebuilds from a run with --history.
+#
+#   scripts/check_history.sh build/absint
+set -u
+
+absint=${1:-build/absint}
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+sh "$root/scripts/generate_program.sh" 5 40 8 > "$work/generated.c"
+status=0
+
+# The interval lines of a store print, "unreachable" alone for bottom.
+intervals() {
+    awk '/^unreachable$/ { bottom = 1 } /^[A-Za-z_][A-Za-z0-9_]* = \[/ { lines[n++] = $0 }
+         END { if (bottom) print "unreachable"; else for (k = 0; k < n; k++) print lines[k] }'
+}
+
+for program in "$root"/tests/*.c "$work/generated.c"; do
+    name=$(basename "$program" .c)
+    if ! "$absint" -I "$root/tests/include" "$program" > "$work/plain" 2>&1 ||
+       ! "$absint" --history "$work/log" -I "$root/tests/include" "$program" > /dev/null 2>&1; then
+        echo "skip $name: the analysis fails"
+        continue
+    fi
+    # Splits the last iteration into one file per location, keeping the store
+    # printed at its end: the lines after the last message, of which a loop
+    # guard prints its poststore first, the same store.
+    rm -f "$work"/store.*
+    awk -v dir="$work" '
+        function flush(    k, first) {
+            if (location == "") return
+            first = start
+            if (poststore && (n - start) % 2 == 0) first = start + (n - start) / 2
+            for (k = first; k < n; k++) print lines[k] > (dir "/store." location)
+            close(dir "/store." location)
+        }
+        /^Iteration / { last = NR }
+        { all[NR] = $0 }
+        END {
+            for (r = last + 1; r <= NR && all[r] !~ /^Fixed point reached/; r++) {
+                line = all[r]
+                if (line ~ /^Evaluating location [0-9]+\.\.\.$/) {
+                    flush()
+                    location = line; sub(/^Evaluating location /, "", location); sub(/\.\.\.$/, "", location)
+                    n = 0; start = 0; poststore = 0
+                    printf "" > (dir "/store." location)
+                    continue
+                }
+                lines[n++] = line
+                if (line !~ /^(unreachable|[A-Za-z_][A-Za-z0-9_]*( = \[| bits |\[-?[0-9]+\.\.| == ).*)$/) {
+                    start = n
+                    poststore = line ~ /^poststore:/
+                }
+            }
+            flush()
+        }' "$work/plain"
+    result="ok  "
+    for store in "$work"/store.*; do
+        [ -e "$store" ] || continue
+        location=${store##*.}
+        intervals < "$store" > "$work/expected"
+        "$absint" --history-query "$work/log" "$location" 2>&1 | intervals > "$work/replayed"
+        if ! cmp -s "$work/expected" "$work/replayed"; then
+            echo "location $location:"
+            diff "$work/expected" "$work/replayed" | head -10
+            result="FAIL"
+            status=1
+        fi
+    done
+    echo "$result $name"
+done
+
+exit $status
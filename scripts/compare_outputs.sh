@@ -0,0 +1,29 @@
+#!/bin/sh
+# Compares the output of two builds of absint on the programs of tests/, for
+# a change that must not alter the results: every difference is printed.
+#
+#   scripts/compare_outputs.sh old/absint new/absint [options...]
+set -u
+
+old=$1
+new=$2
+shift 2
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+status=0
+
+for program in "$root"/tests/*.c; do
+    name=$(basename "$program" .c)
+    "$old" "$@" -I "$root/tests/include" "$program" > "$work/old" 2>&1
+    "$new" "$@" -I "$root/tests/include" "$program" > "$work/new" 2>&1
+    if cmp -s "$work/old" "$work/new"; then
+        echo "same $name"
+    else
+        echo "DIFF $name"
+        diff "$work/old" "$work/new" | head -20
+        status=1
+    fi
+done
+
+exit $status
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Prints a random program of the analyzed language, the same one for the same
+# arguments: `statements` top-level statements (assignments, branches and
+# counted loops) over `variables` variables, some of them bounded by a
+# precondition.
+#
+#   scripts/generate_program.sh seed statements variables > generated.c
+set -eu
+
+seed=${1:-1}
+statements=${2:-1000}
+variables=${3:-20}
+
+awk -v seed="$seed" -v statements="$statements" -v variables="$variables" '
+function pick(n) { return int(rand() * n) }
+function var() { return "v" pick(variables) }
+function constant() { return pick(41) - 20 }
+function comparison() {
+    split("< <= > >= == !=", ops, " ")
+    return var() " " ops[1 + pick(6)] " " constant()
+}
+function assignment(indent,    target, source, c) {
+    target = var(); source = var(); c = constant()
+    if (pick(3) == 0) return indent target " = " c ";"
+    return indent target " = " source (c < 0 ? " - " (-c) : " + " c) ";"
+}
+BEGIN {
+    srand(seed)
+    for (k = 0; k < variables; k++) print "int v" k ";"
+    print "int i;"
+    print ""
+    print "void main() {"
+    for (k = 0; k < variables && k < 4; k++) print "  /*!npk v" k " between " (-pick(10)) " and " pick(10) " */"
+    for (s = 0; s < statements; s++) {
+        r = pick(10)
+        if (r < 6) print assignment("  ")
+        else if (r < 9) {
+            print "  if (" comparison() ") {"
+            print assignment("    ")
+            print "  } else {"
+            print assignment("    ")
+            print "  }"
+        }
+        else {
+            # A counted loop: its inductions have a closed form.
+            print "  i = 0;"
+            print "  while (i < " (1 + pick(20)) ") {"
+            print "    " (target = var()) " = " target " + " (1 + pick(3)) ";"
+            print "    i = i + 1;"
+            print "  }"
+        }
+    }
+    print "  assert(v0 <= v0);"
+    print "}"
+}'
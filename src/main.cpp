@@ -1,31 +1,653 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
+#include <limits>
+#include <memory>
 #include <sstream>
 
+#include <malloc.h>
+
 #include "parser.hpp"
 #include "ast.hpp"
 #include "abstract_interpeter.hpp"
+#include "preprocessor.hpp"
+#include "linker.hpp"
+#include "watcher.hpp"
+#include "batch.hpp"
+#include "snapshot.hpp"
+#include "parallel_solver.hpp"
+#include "parallel_parser.hpp"
+#include "statement_stream.hpp"
+#include "results_database.hpp"
+#include "specialized_analyzer.hpp"
 
-int main(int argc, char** argv) {
-    if(argc != 2) {
-        std::cout << "usage: " << argv[0] << " tests/00.c" << std::endl;
+struct Options {
+    bool karr = false;
+    bool use_profile = false;
+    bool step = false;
+    bool prune_dead = false;
+    bool accelerate = true;
+    std::string arrays = "segmented";
+    std::string solver = "sequential";
+    std::string history;       // log of the store deltas, sequential solver only
+    bool stream = false;       // analyze `main` a window of statements at a time
+    std::string results;       // database of the stores of every program point
+    bool timings = false;      // time and memory of the location graph and the fixpoint
+    std::string specialize;    // cache of the analyzers generated for the programs
+    bool deterministic = false;  // the output does not depend on the threads nor the scheduling
+    unsigned solver_threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+void configure(AbstractInterpreter& interpreter, const Options& options) {
+    if (options.karr) interpreter.enable_affine_equalities();
+    if (options.step) interpreter.enable_stepping();
+    if (options.prune_dead) interpreter.enable_liveness_pruning();
+    if (!options.accelerate) interpreter.disable_acceleration();
+    if (options.arrays == "smashed") interpreter.set_array_segments(1);
+}
+
+// Bytes in use on the heap, 0 where the C library does not tell.
+size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+// Wall time and heap growth since its creation, for --timings.
+struct PhaseTimer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t heap = heap_in_use();
+
+    double milliseconds() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
-    std::ifstream f(argv[1]);
-    if (!f.is_open()){
-        std::cerr << "[ERROR] cannot open the test file `" << argv[1] << "`." << std::endl;
-        return 1;
+    long long kibibytes() const { return (static_cast<long long>(heap_in_use()) - static_cast<long long>(heap)) / 1024; }
+};
+
+void report_timings(size_t locations, double build_ms, long long build_kib, double solve_ms) {
+    report_out() << "Location graph: " << locations << " locations built in " << build_ms << " ms, "
+                 << build_kib << " KiB" << std::endl;
+    report_out() << "Fixpoint: " << solve_ms << " ms" << std::endl;
+}
+
+void solve(AbstractInterpreter& interpreter, const Options& options) {
+    if (options.solver == "async") {
+        size_t evaluations = AsyncSolver(interpreter.get_locations(), options.solver_threads).run();
+        report_out() << "Fixed point reached after " << evaluations << " evaluations" << std::endl;
+    }
+    else if (options.solver == "jacobi") {
+        size_t sweeps = JacobiSolver(interpreter.get_locations(), options.solver_threads).run();
+        report_out() << "Fixed point reached after " << sweeps << " sweeps" << std::endl;
     }
-    std::ostringstream buffer;
-    buffer << f.rdbuf();
-    std::string input = buffer.str();
-    f.close();
+    else interpreter.eval_all();
+}
 
-    std::cout << "Parsing program `" << argv[1] << "`..." << std::endl;
-    AbstractInterpreterParser AIParser;
-    ASTNode ast = AIParser.parse(input);
-    ast.print();
+// Solves the program with the analyzer generated for it (--specialize), false
+// when it cannot be generated or built: the interpreter solves it then.
+bool solve_specialized(AbstractInterpreter& interpreter, const Options& options) {
+    try {
+        std::string why;
+        auto sweeps = SpecializedAnalyzer(options.specialize).solve(interpreter, why);
+        if (!sweeps) {
+            std::cout << "The program cannot be specialized (" << why << "), interpreting it." << std::endl;
+            return false;
+        }
+        report_out() << "Fixed point reached after " << *sweeps - 1 << " iterations" << std::endl;
+        return true;
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << ", interpreting the program." << std::endl;
+        return false;
+    }
+}
+
+// Writes the store of every location of the fixpoint with the source line of
+// its statement, from the origins of the preprocessed lines when known.
+void write_results(const std::string& path, AbstractInterpreter& interpreter, const SourceMap* sources, const std::string& output) {
+    std::vector<const IntervalStore<int64_t>*> stores;
+    std::vector<std::pair<uint32_t, uint32_t>> lines;
+    for (const auto& loc : interpreter.get_locations()) {
+        stores.push_back(&loc->store);
+        lines.push_back(sources != nullptr && loc->offset != std::string::npos ? sources->locate(loc->offset) : std::make_pair(0u, 0u));
+    }
+    try {
+        ResultsDatabase::write(output, stores, lines, sources != nullptr ? sources->files : std::vector<std::string>{path});
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+    }
+}
+
+// `file:line` of an offset of the preprocessed source, for the alarms.
+std::function<std::string(size_t)> statement_locator(const SourceMap& sources) {
+    return [&sources](size_t offset) {
+        auto [file, line] = sources.locate(offset);
+        return line == 0 ? std::string() : sources.files[file] + ":" + std::to_string(line);
+    };
+}
+
+// Returns the stores of the program points, the last one being the exit store.
+std::vector<IntervalStore<int64_t>> analyze_program(const std::string& path, const ASTNode& ast, const Options& options, const SourceMap* sources = nullptr) {
     AbstractInterpreter interpreter;
+    configure(interpreter, options);
+    if (sources != nullptr) interpreter.locate_statements(statement_locator(*sources));
+    AnalysisProfile profile;
+    if (options.use_profile) {
+        profile.load(AnalysisProfile::path_for(path));
+        interpreter.use_profile(&profile);
+    }
+    PhaseTimer build;
     interpreter.create_top_locations(ast);
-    interpreter.eval_all();
+    double build_ms = build.milliseconds();
+    long long build_kib = build.kibibytes();
+    std::unique_ptr<HistoryRecorder> history;
+    if (!options.history.empty()) {
+        history = std::make_unique<HistoryRecorder>(options.history);
+        interpreter.record_history(history.get());
+    }
+    PhaseTimer solving;
+    if (options.specialize.empty() || !solve_specialized(interpreter, options)) solve(interpreter, options);
+    if (options.timings) report_timings(interpreter.get_locations().size(), build_ms, build_kib, solving.milliseconds());
+    if (history != nullptr && !history->close())
+        std::cerr << "[ERROR] cannot write the history `" << options.history << "`." << std::endl;
     interpreter.check_assertions(ast);
+    if (options.use_profile) {
+        interpreter.record_profile();
+        if (!profile.save(AnalysisProfile::path_for(path)))
+            std::cerr << "[ERROR] cannot write the profile `" << AnalysisProfile::path_for(path) << "`." << std::endl;
+    }
+    if (!options.results.empty()) write_results(path, interpreter, sources, options.results);
+    return interpreter.take_stores();
+}
+
+// The statements of `main` are analyzed a window at a time, each window from
+// the exit store of the previous one: the nodes and the stores of a window are
+// dropped once it is solved. Only the assertions are kept, to check them on
+// the exit store as analyze_program does.
+int analyze_stream(const std::string& path, StatementStream& stream, const Options& options, const std::function<std::string(size_t)>& locate) {
+    AnalysisProfile profile;
+    if (options.use_profile) profile.load(AnalysisProfile::path_for(path));
+    ASTNode assertions(NodeType::SEQUENCE, std::string(";"));
+    std::optional<IntervalStore<int64_t>> exit;
+    // The windows add up, the largest graph gives the memory.
+    size_t locations = 0;
+    double build_ms = 0, solve_ms = 0;
+    long long build_kib = 0;
+    try {
+        while (auto statements = stream.next()) {
+            ASTNode ast;
+            if (!exit) ast.children = stream.globals().children;
+            ASTNode body(NodeType::SEQUENCE, std::string(";"));
+            body.children = std::move(*statements);
+            for (const auto& statement : body.children)
+                if (statement.type == NodeType::POST_CON) assertions.children.push_back(statement);
+            ast.children.push_back(std::move(body));
+            ast.print();
+
+            AbstractInterpreter interpreter;
+            configure(interpreter, options);
+            interpreter.locate_statements(locate);
+            if (options.use_profile) interpreter.use_profile(&profile);
+            PhaseTimer build;
+            interpreter.create_top_locations(ast, exit ? &*exit : nullptr);
+            build_ms += build.milliseconds();
+            build_kib = std::max(build_kib, build.kibibytes());
+            locations += interpreter.get_locations().size();
+            PhaseTimer solving;
+            solve(interpreter, options);
+            solve_ms += solving.milliseconds();
+            interpreter.check_bounds();
+            interpreter.record_profile();
+            exit = interpreter.final_store();
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    ASTNode root;
+    root.children.push_back(std::move(assertions));
+    AbstractInterpreter().check_assertions(root, *exit);
+    if (options.timings) report_timings(locations, build_ms, build_kib, solve_ms);
+    if (options.use_profile && !profile.save(AnalysisProfile::path_for(path)))
+        std::cerr << "[ERROR] cannot write the profile `" << AnalysisProfile::path_for(path) << "`." << std::endl;
+    return 0;
+}
+
+// Results of the watch mode, published as immutable snapshots: a new
+// analysis replaces the entry of its program and shares the other ones.
+struct ProgramResult {
+    uint64_t hash;
+    std::vector<IntervalStore<int64_t>> stores;
+};
+
+struct WatchResults {
+    std::map<std::string, std::shared_ptr<const ProgramResult>> programs;
+};
+
+// Answers the queries read from the standard input, `<source> [variable]`,
+// with the exit store of the last analysis of the source. The queries read a
+// pinned snapshot and never wait for an analysis in progress.
+void answer_queries(std::shared_ptr<SnapshotPublisher<WatchResults>> results) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        std::string path, var;
+        if (!(fields >> path)) continue;
+        fields >> var;
+        std::ostringstream answer;
+        {
+            auto snapshot = results->read();
+            const ProgramResult* program = nullptr;
+            if (snapshot.get() != nullptr) {
+                auto it = snapshot->programs.find(path);
+                if (it != snapshot->programs.end() && !it->second->stores.empty()) program = it->second.get();
+            }
+            if (program == nullptr) answer << "[ERROR] no result for `" << path << "`" << std::endl;
+            const auto* exit = program != nullptr ? &program->stores.back() : nullptr;
+            for (const auto& v : exit != nullptr ? exit->get_variables() : std::vector<std::string>()) {
+                if (!var.empty() && v != var) continue;
+                Interval<int64_t> iv = exit->get_interval(v);
+                answer << path << " " << v << " = [" << iv.getLower() << ", " << iv.getUpper() << "]" << std::endl;
+            }
+        }
+        std::cout << answer.str() << std::flush;
+    }
+}
+
+// Analyzes the C sources below `root` and keeps analyzing them as they change.
+// The report of `root/a/b.c` is written to `output/a/b.c.txt`. Only the files
+// whose preprocessed content changed are parsed and analyzed again; the
+// parser, the header cache and the content hashes stay in memory.
+int watch_directory(const std::string& root, const std::string& output, Preprocessor& preprocessor, const Options& options) {
+    namespace fs = std::filesystem;
+    AbstractInterpreterParser AIParser;
+    std::map<std::string, uint64_t> hashes;
+    // Shared with the query thread, which outlives this function on error.
+    auto results = std::make_shared<SnapshotPublisher<WatchResults>>();
+    std::error_code ec;
+    fs::create_directories(output, ec);
+    std::string ignored = fs::weakly_canonical(output, ec).string();
+
+    auto is_source = [](const fs::path& path) { return path.extension() == ".c"; };
+    auto report_path = [&](const std::string& path) {
+        return (fs::path(output) / fs::relative(path, root, ec)).string() + ".txt";
+    };
+    // Copy-on-write of the index only, the results themselves are shared.
+    auto publish = [&](const std::string& path, std::shared_ptr<const ProgramResult> result) {
+        auto next = std::make_unique<WatchResults>();
+        {
+            auto snapshot = results->read();
+            if (snapshot.get() != nullptr) *next = *snapshot;
+        }
+        if (result) next->programs[path] = std::move(result);
+        else next->programs.erase(path);
+        results->publish(std::move(next));
+    };
+    auto reanalyze = [&](const std::string& path) {
+        if (!fs::exists(path, ec)) {
+            if (hashes.erase(path)) {
+                fs::remove(report_path(path), ec);
+                publish(path, nullptr);
+            }
+            return;
+        }
+        std::shared_ptr<ProgramResult> result;
+        std::string report;
+        {
+            ReportCapture capture;
+            try {
+                std::string input = preprocessor.preprocess_file(path);
+                uint64_t hash = content_hash(input);
+                auto known = hashes.find(path);
+                if (known != hashes.end() && known->second == hash) return;
+                hashes[path] = hash;
+                report_out() << "Parsing program `" << path << "`..." << std::endl;
+                result = std::make_shared<ProgramResult>(ProgramResult{hash, analyze_program(path, AIParser.parse(input), options, &preprocessor.source_map())});
+            } catch (const std::runtime_error& e) {
+                hashes.erase(path);
+                report_err() << "[ERROR] " << e.what() << std::endl;
+            }
+            report = capture.str();
+        }
+        publish(path, result);
+        std::cout << "Analyzed `" << path << "`." << std::endl;
+        if (!write_atomically(report_path(path), report))
+            std::cerr << "[ERROR] cannot write the report of `" << path << "`." << std::endl;
+    };
+    auto reanalyze_all = [&]() {
+        std::vector<std::string> known;
+        for (const auto& [path, hash] : hashes) known.push_back(path);
+        for (const auto& path : known)
+            if (!fs::exists(path, ec)) reanalyze(path);
+        for (auto it = fs::recursive_directory_iterator(root, ec); it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_directory(ec) && fs::equivalent(it->path(), ignored, ec)) it.disable_recursion_pending();
+            else if (it->is_regular_file(ec) && is_source(it->path())) reanalyze(it->path().string());
+        }
+    };
+
+    try {
+        DirectoryWatcher watcher(root, ignored);
+        std::thread(answer_queries, results).detach();
+        reanalyze_all();
+        std::cout << "Watching `" << root << "`, the reports are written to `" << output << "`." << std::endl;
+        while (true) {
+            WatchedChanges changed = watcher.wait_changes(std::chrono::milliseconds(200));
+            // A header may be included by any source: the hashes of the
+            // preprocessed sources tell which ones actually changed.
+            bool only_sources = !changed.overflow;
+            for (const auto& path : changed.paths) only_sources = only_sources && is_source(path);
+            if (only_sources) for (const auto& path : changed.paths) reanalyze(path);
+            else reanalyze_all();
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+struct ParsedProgram {
+    std::string path;
+    ASTNode ast;
+    SourceMap sources;
+};
+
+// Independent programs analyzed by a pipeline of `jobs` parsers and `jobs`
+// solvers, see BatchExecutor.
+int analyze_batch(const std::vector<std::string>& paths, const std::vector<std::string>& include_paths, HeaderCache& headers, unsigned jobs, const Options& options) {
+    BatchExecutor executor(jobs);
+    std::vector<std::unique_ptr<AbstractInterpreterParser>> parsers(jobs);
+    std::function<std::optional<ParsedProgram>(size_t, unsigned)> parse = [&](size_t index, unsigned worker) -> std::optional<ParsedProgram> {
+        const std::string& path = paths[index];
+        Preprocessor preprocessor(include_paths, headers);
+        std::string input;
+        try {
+            input = preprocessor.preprocess_file(path);
+        } catch (const std::runtime_error& e) {
+            report_err() << "[ERROR] " << e.what() << std::endl;
+            return std::nullopt;
+        }
+        if (!parsers[worker]) parsers[worker] = std::make_unique<AbstractInterpreterParser>();
+        report_out() << "Parsing program `" << path << "`..." << std::endl;
+        try {
+            ParsedProgram program{path, parsers[worker]->parse(input), preprocessor.source_map()};
+            program.ast.print();
+            return program;
+        } catch (const std::runtime_error& e) {
+            report_err() << "[ERROR] " << e.what() << std::endl;
+            return std::nullopt;
+        }
+    };
+    std::function<void(ParsedProgram&)> solve = [&](ParsedProgram& program) {
+        analyze_program(program.path, program.ast, options, &program.sources);
+    };
+    size_t failures = executor.run(paths.size(), parse, solve, std::cout);
+    return failures == 0 ? 0 : 1;
+}
+
+// The options that change the result of a unit, which its summary depends on.
+// The jacobi solver reaches the same fixpoint on any number of threads.
+std::string unit_settings(const Options& options) {
+    return "arrays=" + options.arrays + (options.accelerate ? " accelerate" : "") + " solver=" + options.solver;
+}
+
+// Several translation units linked together, see Linker.
+int analyze_units(const std::vector<std::string>& paths, Preprocessor& preprocessor, const Options& options, const std::string& summaries) {
+    SummaryDatabase database;
+    Linker linker;
+    if (options.karr) linker.enable_affine_equalities();
+    linker.set_solver(unit_settings(options), [&options](AbstractInterpreter& interpreter, const ASTNode& ast, const Store& entry) {
+        configure(interpreter, options);
+        PhaseTimer build;
+        interpreter.create_top_locations(ast, &entry);
+        double build_ms = build.milliseconds();
+        long long build_kib = build.kibibytes();
+        PhaseTimer solving;
+        solve(interpreter, options);
+        if (options.timings) report_timings(interpreter.get_locations().size(), build_ms, build_kib, solving.milliseconds());
+    });
+    if (!summaries.empty()) {
+        database.load(summaries);
+        linker.set_database(&database);
+    }
+    AbstractInterpreterParser AIParser;
+    try {
+        for (const auto& path : paths) {
+            std::string input = preprocessor.preprocess_file(path);
+            std::cout << "Parsing program `" << path << "`..." << std::endl;
+            linker.add_unit(path, content_hash(input), AIParser.parse(input));
+        }
+        linker.analyze();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << linker.get_reused() << " unit(s) reused from the summaries." << std::endl;
+    if (!summaries.empty() && !database.save(summaries)) {
+        std::cerr << "[ERROR] cannot write the summaries `" << summaries << "`." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// `--history-query log [location [iteration]]`: the locations and variables
+// changed at every iteration, or the store of a location at the end of an
+// iteration (the last one by default, -1 for the initial store).
+int query_history(const std::vector<std::string>& args) {
+    try {
+        HistoryReader reader(args[0]);
+        if (args.size() == 1) {
+            auto changes = reader.changes();
+            for (size_t n = 0; n < changes.size(); ++n)
+                std::cout << "Iteration " << static_cast<int64_t>(n) - 1 << ": " << changes[n].first << " location(s), "
+                          << changes[n].second << " variable(s) changed" << std::endl;
+            return 0;
+        }
+        size_t location = std::stoul(args[1]);
+        int64_t iteration = args.size() > 2 ? std::stoll(args[2]) : std::numeric_limits<int64_t>::max();
+        reader.store_at(location, iteration).print();
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// A point is `@location`, `file:line`, or a line of the analyzed file.
+int query_results(const std::vector<std::string>& args) {
+    try {
+        ResultsDatabase db(args[0]);
+        auto answer = [&db](const std::string& point, const std::string& var) {
+            std::vector<size_t> found;
+            if (!point.empty() && point[0] == '@') found.push_back(std::stoul(point.substr(1)));
+            else {
+                size_t colon = point.rfind(':');
+                auto file = colon == std::string::npos ? std::optional<uint32_t>(0) : db.file_id(point.substr(0, colon));
+                if (!file) throw std::runtime_error("no file `" + point.substr(0, colon) + "` in the results");
+                found = db.locations_at(*file, static_cast<uint32_t>(std::stoul(colon == std::string::npos ? point : point.substr(colon + 1))));
+                if (found.empty()) std::cout << point << ": no program point" << std::endl;
+            }
+            for (size_t location : found) {
+                auto [file, line] = db.position(location);
+                std::cout << "location " << location;
+                if (line != 0) std::cout << " (" << db.file(file) << ":" << line << ")";
+                if (db.is_bottom(location)) {
+                    std::cout << ": unreachable" << std::endl;
+                    continue;
+                }
+                std::cout << ":" << std::endl;
+                for (const auto& [name, iv] : db.intervals(location)) {
+                    if (!var.empty() && name != var) continue;
+                    std::cout << "  " << name << " = [" << iv.getLower() << ", " << iv.getUpper() << "]" << std::endl;
+                }
+            }
+        };
+        if (args.size() > 1) {
+            answer(args[1], args.size() > 2 ? args[2] : "");
+            return 0;
+        }
+        // One query per line of the standard input: `point [variable]`.
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::istringstream fields(line);
+            std::string point, var;
+            if (!(fields >> point)) continue;
+            fields >> var;
+            try {
+                answer(point, var);
+            } catch (const std::exception& e) {
+                std::cout << "[ERROR] " << e.what() << std::endl;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    Options options;
+    std::string summaries;
+    std::string watch_output;
+    bool batch = false;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    unsigned parse_threads = jobs;
+    std::vector<std::string> include_paths;
+    if (argc > 2 && std::string(argv[1]) == "--history-query")
+        return query_history(std::vector<std::string>(argv + 2, argv + std::min(argc, 5)));
+    if (argc > 2 && std::string(argv[1]) == "--results-query")
+        return query_results(std::vector<std::string>(argv + 2, argv + std::min(argc, 5)));
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--karr") options.karr = true;
+        else if (arg == "--profile") options.use_profile = true;
+        else if (arg == "--step") options.step = true;
+        else if (arg == "--prune-dead") options.prune_dead = true;
+        else if (arg == "--no-accelerate") options.accelerate = false;
+        else if (arg == "--arrays" && i + 1 < argc) options.arrays = argv[++i];
+        else if (arg == "--watch" && i + 1 < argc) watch_output = argv[++i];
+        else if (arg == "--batch") batch = true;
+        else if (arg == "--deterministic") options.deterministic = true;
+        else if (arg == "--solver" && i + 1 < argc) options.solver = argv[++i];
+        else if (arg == "--stream") options.stream = true;
+        else if (arg == "--history" && i + 1 < argc) options.history = argv[++i];
+        else if (arg == "--results" && i + 1 < argc) options.results = argv[++i];
+        else if (arg == "--timings") options.timings = true;
+        else if (arg == "--specialize" && i + 1 < argc) options.specialize = argv[++i];
+        else if (arg == "--solver-threads" && i + 1 < argc) options.solver_threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--parse-threads" && i + 1 < argc) parse_threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--jobs" && i + 1 < argc) jobs = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--summaries" && i + 1 < argc) summaries = argv[++i];
+        else if (arg == "-I" && i + 1 < argc) include_paths.push_back(argv[++i]);
+        else if (arg.rfind("-I", 0) == 0) include_paths.push_back(arg.substr(2));
+        else paths.push_back(arg);
+    }
+    if (options.solver != "sequential" && options.solver != "async" && options.solver != "jacobi") {
+        std::cerr << "[ERROR] unknown solver `" << options.solver << "`, expected sequential, async or jacobi." << std::endl;
+        return 1;
+    }
+    // The reports of a batch are the same byte for byte for any --jobs.
+    if (batch) options.deterministic = true;
+    if (options.deterministic && (options.solver == "async" || options.timings)) {
+        std::cerr << "[ERROR] --deterministic and --batch refuse --solver async and --timings, whose output depends on the scheduling." << std::endl;
+        return 1;
+    }
+    if (options.solver == "async" && (!watch_output.empty() || !options.results.empty() || !summaries.empty())) {
+        std::cerr << "[ERROR] --solver async depends on the scheduling, --watch, --results and --summaries refuse it." << std::endl;
+        return 1;
+    }
+    if (options.arrays != "smashed" && options.arrays != "segmented") {
+        std::cerr << "[ERROR] unknown array abstraction `" << options.arrays << "`, expected smashed or segmented." << std::endl;
+        return 1;
+    }
+    if (!options.history.empty() && (options.solver != "sequential" || batch || !watch_output.empty() || paths.size() > 1 || !summaries.empty())) {
+        std::cerr << "[ERROR] --history records a single program solved by the sequential solver." << std::endl;
+        return 1;
+    }
+    if (!options.results.empty() && (options.stream || batch || !watch_output.empty() || paths.size() > 1 || !summaries.empty())) {
+        std::cerr << "[ERROR] --results records a single program analyzed as a whole." << std::endl;
+        return 1;
+    }
+    if (options.stream && (options.prune_dead || !options.history.empty() || batch || !watch_output.empty() || paths.size() > 1 || !summaries.empty())) {
+        std::cerr << "[ERROR] --stream analyzes a single program, without --prune-dead nor --history." << std::endl;
+        return 1;
+    }
+    if (!options.specialize.empty() && (options.karr || options.prune_dead || options.use_profile || options.step || options.stream || !options.history.empty()
+                                        || options.solver != "sequential" || batch || !watch_output.empty() || paths.size() > 1 || !summaries.empty())) {
+        std::cerr << "[ERROR] --specialize solves a single program as the sequential solver, without --karr, --prune-dead, --profile, --step, --stream nor --history." << std::endl;
+        return 1;
+    }
+    // The exit store of a unit keeps every global for the next units, and the
+    // thresholds of a profile are learnt on a single program.
+    if ((options.prune_dead || options.use_profile) && !batch && watch_output.empty() && (paths.size() > 1 || !summaries.empty())) {
+        std::cerr << "[ERROR] several units and --summaries refuse --prune-dead and --profile." << std::endl;
+        return 1;
+    }
+    if (paths.empty()) {
+        std::cout << "usage: " << argv[0] << " [--karr] [--profile] [--step] [--prune-dead] [--no-accelerate] [--arrays smashed|segmented] [--deterministic] [--solver sequential|async|jacobi] [--solver-threads n] [--parse-threads n] [--stream] [--history log] [--results db] [--timings] [--specialize cache_dir] [--summaries db] [-I dir]... tests/00.c [more units...]" << std::endl;
+        std::cout << "       " << argv[0] << " --batch [--jobs n] [--karr] [--profile] [--prune-dead] [--no-accelerate] [--arrays smashed|segmented] [--solver sequential|jacobi] [--solver-threads n] [-I dir]... tests/00.c tests/01.c..." << std::endl;
+        std::cout << "       " << argv[0] << " --history-query log [location [iteration]]" << std::endl;
+        std::cout << "       " << argv[0] << " --results-query db [@location|file:line|line [variable]]" << std::endl;
+        std::cout << "       " << argv[0] << " --watch output_dir [--karr] [--prune-dead] [-I dir]... source_dir" << std::endl;
+        return 1;
+    }
+
+    HeaderCache headers;
+    Preprocessor preprocessor(include_paths, headers);
+    if (!watch_output.empty())
+        return watch_directory(paths[0], watch_output, preprocessor, options);
+    if (batch)
+        return analyze_batch(paths, include_paths, headers, jobs, options);
+    if (paths.size() > 1 || !summaries.empty())
+        return analyze_units(paths, preprocessor, options, summaries);
+
+    const char* path = paths[0].c_str();
+    if (options.stream) {
+        // A source the preprocessor would not change but for its layout is
+        // streamed from its mapping, without a preprocessed copy.
+        std::unique_ptr<MappedFile> file;
+        try {
+            file = std::make_unique<MappedFile>(path);
+        } catch (const std::runtime_error&) {}   // reported by the preprocessor below
+        if (file != nullptr && StatementStream::plain(file->text())) {
+            StatementStream stream(file->text());
+            if (stream.open()) {
+                std::cout << "Streaming program `" << path << "`..." << std::endl;
+                return analyze_stream(path, stream, options, [&stream, path](size_t offset) { return std::string(path) + ":" + std::to_string(stream.line_at(offset)); });
+            }
+        }
+    }
+
+    std::string input;
+    try {
+        input = preprocessor.preprocess_file(path);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options.stream) {
+        StatementStream stream(input);
+        if (stream.open()) {
+            std::cout << "Streaming program `" << path << "`..." << std::endl;
+            return analyze_stream(path, stream, options, statement_locator(preprocessor.source_map()));
+        }
+        std::cout << "`main` of `" << path << "` cannot be split into statements, analyzing it as a whole." << std::endl;
+    }
+
+    std::cout << "Parsing program `" << path << "`..." << std::endl;
+    // The parsers of the other threads are only built for a large source.
+    ParallelParser parser(input.size() >= ParallelParser::min_parallel_size ? parse_threads : 1);
+    ASTNode ast;
+    try {
+        ast = parser.parse(input);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    ast.print();
+    analyze_program(path, ast, options, &preprocessor.source_map());
     return 0;
 }
@@ -0,0 +1,17 @@
+int a[100];
+int i;
+int x;
+int y;
+
+void main() {
+  /*!npk i between 0 and 99 */
+  a[0] = 1;
+  a[1] = 2;
+  // Segmented: a[0..0] = [1, 1], a[1..1] = [2, 2], a[2..99] at top.
+  x = a[1];
+  // Alarm: the index is in [1, 100].
+  y = a[i + 1];
+  // Only with the segmented arrays; smashed, x is top.
+  assert(x <= 2);
+  assert(x >= 2);
+}
@@ -0,0 +1,15 @@
+int a;
+int x;
+int y;
+
+void main() {
+  /*!npk a between 0 and 1000 */
+  x = a & 240;
+  // The low bits of `x` are known to be 0, not only its interval.
+  y = x & 15;
+  assert(y == 0);
+  y = (a << 2) | 1;
+  assert(y >= 1);
+  y = a % 8;
+  assert(y <= 7);
+}
@@ -0,0 +1,17 @@
+int x;
+int y;
+int z;
+int w;
+
+void main() {
+  /*!npk x between 0 and 15 */
+  // As in C, the comparisons bind tighter than `&`, `^` and `|`: this is
+  // x & (1 == 0), so always 0.
+  y = x & 1 == 0;
+  assert(y == 0);
+  // A comparison used as a value is 1 where it holds and 0 where it fails.
+  z = (x & 1) == 0;
+  assert(z <= 1);
+  w = x < 16 | 2;
+  assert(w == 3);
+}
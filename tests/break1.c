@@ -0,0 +1,16 @@
+int i;
+int x;
+
+void main() {
+  i = 0;
+  x = 0;
+  while (i <= 100) {
+    int t = 5;
+    i = i + 1;
+    if (i >= 10) break;
+    if (i <= 3) continue;
+    x = i;
+  }
+  // The loop is left by the break, with t out of scope.
+  assert(x <= 9);
+}
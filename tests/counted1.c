@@ -0,0 +1,14 @@
+int x;
+int y;
+
+void main() {
+  /*!npk x between 0 and 4 */
+  y = 100;
+  while (x < 50) {
+    y = y - 3;
+    x = x + 7;
+  }
+  // Closed form: x leaves in [50, 56] after 7 or 8 iterations, y in [76, 79].
+  assert(x <= 56);
+  assert(y >= 76);
+}
@@ -0,0 +1,14 @@
+int i;
+int j;
+
+void main() {
+  /*!npk i between 0 and 3 */
+  j = i;
+  while (i < 10) {
+    i = i + 1;
+  }
+  // The closed form of the counter is not given to `j`, equal to `i` only
+  // before the loop: `j` leaves it with its own [0, 3].
+  assert(i == 10);
+  assert(j <= 3);
+}
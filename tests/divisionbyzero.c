@@ -9,7 +9,7 @@ void main() {
   c = c / d;
   /*!npk a between 2 and 4 */
   b = (a * a) / a;
-  // Note the loss of precision with interval analysis.
+  // The linearization cancels `a` symbolically: b is in [2, 4].
   assert(b >= 1);
   assert(b <= 8);
 }
@@ -0,0 +1,13 @@
+int a;
+int b;
+
+void main() {
+  /*!npk a between 0 and 20 */
+  b = a;
+  if(a <= 5) {
+    b = b + 1;
+  }
+  // The guard on `a` also refines `b` since both are known to be equal.
+  assert(b <= 20);
+  assert(b >= 0);
+}
@@ -0,0 +1,23 @@
+int i;
+int x;
+int y;
+int z;
+
+void main() {
+  /*!npk x between 0 and 20 */
+  /*!npk y between 0 and 5 */
+  z = 0;
+  // y > 3 is only refined where x < 10 holds.
+  if (x < 10 && y > 3) {
+    z = x + y;
+  }
+  if (!(x < 10 || y > 3)) {
+    z = x;
+  }
+  i = 0;
+  while (i < 100 && !(i == x)) {
+    i = i + 1;
+  }
+  assert(z <= 20);
+  assert(i <= 100);
+}
@@ -0,0 +1,7 @@
+#ifndef LOOP_CONFIG_H
+#define LOOP_CONFIG_H
+
+#define LIMIT 10
+#define STEP(x) ((x) + 2)
+
+#endif
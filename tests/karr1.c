@@ -0,0 +1,13 @@
+int i;
+int j;
+
+void main() {
+  i = 0;
+  j = 0;
+  while (i <= 10) {
+    i = i + 1;
+    j = j + 2;
+  }
+  // Needs `--karr`: the intervals alone never bound `j`.
+  assert(j == 22);
+}
@@ -0,0 +1,18 @@
+int i;
+int y;
+int z;
+int n;
+
+void main() {
+  /*!npk n between 0 and 100 */
+  i = 0;
+  y = 0;
+  z = n;
+  while (i <= 10) {
+    y = i * 2;
+    i = i + 1;
+  }
+  // Only i is checked: with --prune-dead, y, z and n (only read to assign the
+  // dead z) leave the stores, and the loop head only joins i.
+  assert(i == 11);
+}
@@ -0,0 +1,19 @@
+#include "include/loop_config.h"
+#include "include/loop_config.h"
+
+int x;
+
+void main() {
+  x = 1;
+  while (x <= LIMIT) {
+    x = STEP(x);
+  }
+#ifdef LIMIT
+  assert(x == LIMIT + 1);
+#endif
+#if LIMIT * 2 > 16 && (STEP(0) & 1) == 0 && '0' == 48
+  assert(x >= LIMIT);
+#else
+  assert(x < 0);
+#endif
+}
@@ -0,0 +1,18 @@
+int i;
+int x;
+
+void main() {
+  i = 0;
+  x = 3;
+  while (i <= 10) {
+    int t = 0;
+    t = t + i;
+    i = i + 1;
+  }
+  {
+    int x = 100;
+    x = x + 1;
+  }
+  // t is not in the stores after the loop body, and the outer x is back.
+  assert(x == 3);
+}
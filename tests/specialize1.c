@@ -0,0 +1,22 @@
+int n;
+int i;
+int s;
+int t;
+
+void main() {
+  /*!npk n between 0 and 20 */
+  s = 0;
+  i = 0;
+  while (i < n) {
+    t = i % 4;
+    if (t == 0 || t > 2) {
+      s = s + 2;
+    } else {
+      s = s + 1;
+    }
+    i = i + 1;
+  }
+  // The same analyzer, loaded from the cache, runs for any bounds of n.
+  assert(i <= 20);
+  assert(s >= 0);
+}
@@ -0,0 +1,6 @@
+int limit = 10;
+int count;
+
+void main() {
+  count = 0;
+}
@@ -0,0 +1,7 @@
+int limit;
+int count;
+
+void main() {
+  count = count + limit;
+  assert(count == 10);
+}